@@ -1,16 +1,41 @@
 #include "ocr_engine.h"
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 #include <vector>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <stdexcept>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <deque>
+#include <map>
+#include <exception>
 #include <numeric>
 #include <algorithm>
+#include <limits>
 #include <math.h>
+#include <limits.h>
 #include "clipper.h"
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #ifdef WITH_LITE
 #include <paddle_api.h>
 using namespace paddle::lite_api;
@@ -36,6 +61,37 @@ public:
         return m_vec;
     }
 
+    static std::string ReadFile(const std::string &path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("cannot open " + path);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+
+    // Reads the frame size from a JPEG's SOF segment without decoding it
+    static bool JpegSize(const uint8_t *data, size_t len, int &width, int &height) {
+        if (len < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+        size_t pos = 2;
+        while (pos + 4 <= len) {
+            if (data[pos] != 0xFF) return false;
+            uint8_t marker = data[pos + 1];
+            if (marker == 0xFF) {
+                pos++;
+                continue;
+            }
+            size_t seg_len = (data[pos + 2] << 8) | data[pos + 3];
+            bool sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+            if (sof) {
+                if (pos + 9 > len) return false;
+                height = (data[pos + 5] << 8) | data[pos + 6];
+                width = (data[pos + 7] << 8) | data[pos + 8];
+                return width > 0 && height > 0;
+            }
+            if (marker == 0xDA || seg_len < 2) return false;
+            pos += 2 + seg_len;
+        }
+        return false;
+    }
+
     static int argmax(const float *start, const float *end) {
         return std::distance(start, std::max_element(start, end));
     }
@@ -45,357 +101,2134 @@ public:
         if (x < min) return min;
         return x;
     }
+
+    // Runs fn(index, worker) for every index in [0, count) on up to `threads`
+    // threads, the calling thread included. The first exception is rethrown
+    // once all workers have finished.
+    static void ParallelFor(int count, int threads, const std::function<void(int, int)> &fn) {
+        threads = std::max(1, std::min(threads, count));
+        if (threads == 1) {
+            for (int i = 0; i < count; i++) fn(i, 0);
+            return;
+        }
+        std::atomic<int> next(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto worker = [&](int worker_id) {
+            for (int i = next++; i < count; i = next++) {
+                try {
+                    fn(i, worker_id);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) error = std::current_exception();
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++) workers.emplace_back(worker, t);
+        worker(0);
+        for (auto &t : workers) t.join();
+        if (error) std::rethrow_exception(error);
+    }
 };
 
-// --- Preprocessing ---
-class Preprocessor {
+// --- Input Files ---
+// Read-only view of a whole file. Files of at least kMapThreshold bytes are
+// memory-mapped so the decoder reads the page cache directly; smaller ones,
+// or files that cannot be mapped, are read in one call.
+class MappedFile {
 public:
-    static void Normalize(cv::Mat *im, const std::vector<float> &mean,
-                          const std::vector<float> &scale, const bool is_scale) {
-        double e = is_scale ? 1.0 / 255.0 : 1.0;
-        im->convertTo(*im, CV_32FC3, e);
-        for (int h = 0; h < im->rows; h++) {
-            for (int w = 0; w < im->cols; w++) {
-                cv::Vec3f &val = im->at<cv::Vec3f>(h, w);
-                val[0] = (val[0] - mean[0]) * scale[0];
-                val[1] = (val[1] - mean[1]) * scale[1];
-                val[2] = (val[2] - mean[2]) * scale[2];
+    MappedFile() {}
+    ~MappedFile() { Close(); }
+
+    bool Open(const std::string &path) {
+        Close();
+#ifdef _WIN32
+        // Paths are UTF-8; fall back to the ANSI code page for legacy callers
+        std::wstring wpath;
+        for (UINT cp : {(UINT)CP_UTF8, (UINT)CP_ACP}) {
+            DWORD flags = cp == CP_UTF8 ? MB_ERR_INVALID_CHARS : 0;
+            int n = MultiByteToWideChar(cp, flags, path.c_str(), -1, nullptr, 0);
+            if (n <= 0) continue;
+            wpath.resize(n);
+            MultiByteToWideChar(cp, flags, path.c_str(), -1, &wpath[0], n);
+            break;
+        }
+        HANDLE file = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0 ||
+            (unsigned long long)file_size.QuadPart > (size_t)-1) {
+            CloseHandle(file);
+            return false;
+        }
+        size_ = (size_t)file_size.QuadPart;
+        if (size_ >= kMapThreshold) {
+            HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) {
+                map_ = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+        }
+        bool ok = map_ != nullptr;
+        if (!ok) {
+            buffer_.resize(size_);
+            size_t done = 0;
+            while (done < size_) {
+                DWORD chunk = (DWORD)std::min<size_t>(size_ - done, 1u << 30);
+                DWORD got = 0;
+                if (!::ReadFile(file, &buffer_[done], chunk, &got, nullptr) || got == 0) break;
+                done += got;
+            }
+            ok = done == size_;
+        }
+        CloseHandle(file);
+#else
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            close(fd);
+            return false;
+        }
+        size_ = (size_t)st.st_size;
+        if (size_ >= kMapThreshold) {
+            void *map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                // Start fetching the whole file now rather than fault by fault
+                madvise(map, size_, MADV_WILLNEED);
+                map_ = map;
+            }
+        }
+        bool ok = map_ != nullptr;
+        if (!ok) {
+            buffer_.resize(size_);
+            size_t done = 0;
+            while (done < size_) {
+                ssize_t got = read(fd, &buffer_[done], size_ - done);
+                if (got < 0 && errno == EINTR) continue;
+                if (got <= 0) break;
+                done += (size_t)got;
             }
+            ok = done == size_;
+        }
+        close(fd);
+#endif
+        if (!ok) Close();
+        return ok;
+    }
+
+    const uint8_t* Data() const { return map_ ? static_cast<const uint8_t*>(map_) : buffer_.data(); }
+    size_t Size() const { return size_; }
+
+private:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    void Close() {
+        if (map_) {
+#ifdef _WIN32
+            UnmapViewOfFile(map_);
+#else
+            munmap(map_, size_);
+#endif
         }
+        map_ = nullptr;
+        size_ = 0;
+        buffer_.clear();
     }
 
-    static void Permute(const cv::Mat *im, float *data) {
-        int rh = im->rows;
-        int rw = im->cols;
-        int rc = im->channels();
-        for (int i = 0; i < rc; ++i) {
-            cv::extractChannel(*im, cv::Mat(rh, rw, CV_32FC1, data + i * rh * rw), i);
+    static const size_t kMapThreshold = 64 * 1024;
+
+    void *map_ = nullptr;
+    size_t size_ = 0;
+    std::vector<uint8_t> buffer_;
+};
+
+// --- Input Images ---
+// Caller pixels wrapped without copying, in their native layout. NV12 keeps
+// the Y plane in `mat` and the interleaved half-resolution UV plane in `uv`.
+struct SourceImage {
+    cv::Mat mat;
+    cv::Mat uv;
+    int format;
+
+    SourceImage() : format(OCR_PIXEL_BGR) {}
+    explicit SourceImage(const cv::Mat &bgr) : mat(bgr), format(OCR_PIXEL_BGR) {}
+
+    static bool Wrap(const uint8_t *pixels, int width, int height, int stride, int format, SourceImage &out) {
+        static const int kChannels[] = {3, 3, 4, 4, 1, 1};
+        if (!pixels || width <= 0 || height <= 0 || format < OCR_PIXEL_BGR || format > OCR_PIXEL_NV12) return false;
+        int row_bytes = width * kChannels[format];
+        if (stride == 0) stride = row_bytes;
+        if (stride < row_bytes) return false;
+        out.format = format;
+        out.mat = cv::Mat(height, width, CV_8UC(kChannels[format]), (void*)pixels, stride);
+        out.uv.release();
+        if (format == OCR_PIXEL_NV12) {
+            if (width % 2 || height % 2) return false;
+            out.uv = cv::Mat(height / 2, width / 2, CV_8UC2, (void*)(pixels + (size_t)stride * height), stride);
         }
+        return true;
     }
 
-    static void ResizeDet(const cv::Mat &img, cv::Mat &resize_img, int max_size_len, float &ratio_h, float &ratio_w) {
-        int w = img.cols;
-        int h = img.rows;
+    int Rows() const { return mat.rows; }
+    int Cols() const { return mat.cols; }
+
+    // View of a sub-rectangle; NV12 needs even coordinates and sizes
+    SourceImage Region(const cv::Rect &rect) const {
+        SourceImage out;
+        out.format = format;
+        out.mat = mat(rect);
+        if (format == OCR_PIXEL_NV12) {
+            out.uv = uv(cv::Rect(rect.x / 2, rect.y / 2, rect.width / 2, rect.height / 2));
+        }
+        return out;
+    }
+
+    // cvtColor code from the native layout to BGR, or -1 if already BGR
+    int ToBGRCode() const {
+        switch (format) {
+            case OCR_PIXEL_RGB: return cv::COLOR_RGB2BGR;
+            case OCR_PIXEL_BGRA: return cv::COLOR_BGRA2BGR;
+            case OCR_PIXEL_RGBA: return cv::COLOR_RGBA2BGR;
+            case OCR_PIXEL_GRAY: return cv::COLOR_GRAY2BGR;
+            default: return -1;
+        }
+    }
+
+    // Full-resolution image that crops are warped from. Everything except
+    // NV12 is warped in its native layout and converted per crop.
+    cv::Mat CropSource() const {
+        if (format != OCR_PIXEL_NV12) return mat;
+        cv::Mat bgr;
+        cv::cvtColorTwoPlane(mat, uv, bgr, cv::COLOR_YUV2BGR_NV12);
+        return bgr;
+    }
+};
+
+// --- Preprocessing ---
+class Preprocessor {
+public:
+    // Fused uint8 BGR -> normalized planar float in one pass:
+    // data[c][y][x] = (im[y][x][c] * e - mean[c]) * scale[c]
+    static void NormalizePermute(const cv::Mat &im, const float mean[3], const float scale[3], const bool is_scale,
+                                 float *data) {
+        float e = is_scale ? 1.f / 255.f : 1.f;
+        float alpha[3], beta[3];
+        for (int c = 0; c < 3; c++) {
+            alpha[c] = e * scale[c];
+            beta[c] = -mean[c] * scale[c];
+        }
+        int rh = im.rows;
+        int rw = im.cols;
+        float *planes[3] = {data, data + rh * rw, data + 2 * rh * rw};
+#if CV_SIMD128
+        cv::v_float32x4 va[3], vb[3];
+        for (int c = 0; c < 3; c++) {
+            va[c] = cv::v_setall_f32(alpha[c]);
+            vb[c] = cv::v_setall_f32(beta[c]);
+        }
+#endif
+        for (int h = 0; h < rh; h++) {
+            const uchar *src = im.ptr<uchar>(h);
+            float *dst[3] = {planes[0] + h * rw, planes[1] + h * rw, planes[2] + h * rw};
+            int w = 0;
+#if CV_SIMD128
+            for (; w <= rw - 16; w += 16) {
+                cv::v_uint8x16 v[3];
+                cv::v_load_deinterleave(src + w * 3, v[0], v[1], v[2]);
+                for (int c = 0; c < 3; c++) {
+                    cv::v_uint16x8 lo, hi;
+                    cv::v_uint32x4 q[4];
+                    cv::v_expand(v[c], lo, hi);
+                    cv::v_expand(lo, q[0], q[1]);
+                    cv::v_expand(hi, q[2], q[3]);
+                    for (int j = 0; j < 4; j++) {
+                        cv::v_float32x4 f = cv::v_cvt_f32(cv::v_reinterpret_as_s32(q[j]));
+                        cv::v_store(dst[c] + w + j * 4, cv::v_fma(f, va[c], vb[c]));
+                    }
+                }
+            }
+#endif
+            for (; w < rw; w++) {
+                for (int c = 0; c < 3; c++) {
+                    dst[c][w] = src[w * 3 + c] * alpha[c] + beta[c];
+                }
+            }
+        }
+    }
+
+    static void DetResizeShape(int w, int h, int max_size_len, int &resize_w, int &resize_h) {
         float ratio = 1.f;
         int max_wh = std::max(w, h);
         if (max_wh > max_size_len) {
             ratio = float(max_size_len) / float(max_wh);
         }
-        int resize_h = int(float(h) * ratio);
-        int resize_w = int(float(w) * ratio);
+        resize_h = int(float(h) * ratio);
+        resize_w = int(float(w) * ratio);
         resize_h = std::max(32, (resize_h / 32) * 32);
         resize_w = std::max(32, (resize_w / 32) * 32);
+    }
+
+    static void ResizeDet(const cv::Mat &img, cv::Mat &resize_img, int max_size_len, float &ratio_h, float &ratio_w) {
+        int w = img.cols;
+        int h = img.rows;
+        int resize_w, resize_h;
+        DetResizeShape(w, h, max_size_len, resize_w, resize_h);
         cv::resize(img, resize_img, cv::Size(resize_w, resize_h));
         ratio_h = float(resize_h) / float(h);
         ratio_w = float(resize_w) / float(w);
     }
 
+    // Resizes in the source layout first so the color conversion only
+    // touches the small detection image.
+    static void ResizeDet(const SourceImage &img, cv::Mat &resize_img, int max_size_len, float &ratio_h, float &ratio_w) {
+        if (img.format == OCR_PIXEL_BGR) {
+            ResizeDet(img.mat, resize_img, max_size_len, ratio_h, ratio_w);
+            return;
+        }
+        int w = img.Cols();
+        int h = img.Rows();
+        int resize_w, resize_h;
+        DetResizeShape(w, h, max_size_len, resize_w, resize_h);
+        cv::Mat native;
+        if (img.format == OCR_PIXEL_NV12) {
+            cv::Mat uv;
+            cv::resize(img.mat, native, cv::Size(resize_w, resize_h));
+            cv::resize(img.uv, uv, cv::Size(resize_w / 2, resize_h / 2));
+            cv::cvtColorTwoPlane(native, uv, resize_img, cv::COLOR_YUV2BGR_NV12);
+        } else {
+            cv::resize(img.mat, native, cv::Size(resize_w, resize_h));
+            cv::cvtColor(native, resize_img, img.ToBGRCode());
+        }
+        ratio_h = float(resize_h) / float(h);
+        ratio_w = float(resize_w) / float(w);
+    }
+
+    // Resizes to height rec_h and zero-pads on the right up to rec_w. An
+    // output that already has that geometry (e.g. a scratch view) is filled
+    // in place.
     static void ResizeRec(const cv::Mat &img, cv::Mat &resize_img, int rec_h, int rec_w) {
         float ratio = float(img.cols) / float(img.rows);
         int w = int(ceilf(float(rec_h) * ratio));
         if (w > rec_w) w = rec_w;
-        cv::resize(img, resize_img, cv::Size(w, rec_h), 0.f, 0.f, cv::INTER_LINEAR);
+        resize_img.create(rec_h, rec_w, img.type());
+        cv::Mat content = resize_img.colRange(0, w);
+        if (img.size() == content.size()) {
+            img.copyTo(content);
+        } else {
+            cv::resize(img, content, cv::Size(w, rec_h), 0.f, 0.f, cv::INTER_LINEAR);
+        }
         if (w < rec_w) {
-            cv::copyMakeBorder(resize_img, resize_img, 0, 0, 0, rec_w - w, cv::BORDER_CONSTANT, cv::Scalar(0, 0, 0));
+            resize_img.colRange(w, rec_w).setTo(cv::Scalar(0, 0, 0));
+        }
+    }
+};
+
+// --- Scratch Memory ---
+// Bump allocator for the buffers and cv::Mat pixels of one request. Memory
+// stays valid until Rewind/Reset; blocks are kept across requests, and a
+// request that spilled over several blocks leaves one block sized to the
+// high-water mark behind.
+class ScratchArena {
+public:
+    struct Mark {
+        size_t block, offset, used;
+    };
+
+    void* Alloc(size_t bytes) {
+        bytes = (bytes + kAlign - 1) & ~(kAlign - 1);
+        while (block_ < blocks_.size() && offset_ + bytes > blocks_[block_].size) {
+            block_++;
+            offset_ = 0;
+        }
+        if (block_ == blocks_.size()) {
+            blocks_.push_back(Block(std::max(bytes, capacity_.load())));
+            capacity_ += blocks_.back().size;
+            offset_ = 0;
+        }
+        uchar *ptr = blocks_[block_].data + offset_;
+        offset_ += bytes;
+        used_ += bytes;
+        peak_ = std::max(peak_, used_);
+        return ptr;
+    }
+
+    float* Floats(size_t count) { return static_cast<float*>(Alloc(count * sizeof(float))); }
+
+    cv::Mat Mat(int rows, int cols, int type) {
+        return cv::Mat(rows, cols, type, Alloc((size_t)rows * cols * CV_ELEM_SIZE(type)));
+    }
+
+    Mark GetMark() const { return {block_, offset_, used_}; }
+
+    void Rewind(const Mark &mark) {
+        block_ = mark.block;
+        offset_ = mark.offset;
+        used_ = mark.used;
+    }
+
+    void Reset() {
+        if (blocks_.size() > 1) {
+            blocks_.clear();
+            blocks_.push_back(Block(peak_));
+            capacity_ = peak_;
+        }
+        block_ = offset_ = used_ = 0;
+    }
+
+    size_t Capacity() const { return capacity_; }
+
+    size_t Trim() {
+        size_t freed = capacity_;
+        blocks_.clear();
+        capacity_ = 0;
+        block_ = offset_ = used_ = peak_ = 0;
+        return freed;
+    }
+
+private:
+    static const size_t kAlign = 64;
+
+    struct Block {
+        explicit Block(size_t bytes) : storage(new uchar[bytes + kAlign]), size(bytes) {
+            data = reinterpret_cast<uchar*>((reinterpret_cast<uintptr_t>(storage.get()) + kAlign - 1) & ~(uintptr_t)(kAlign - 1));
+        }
+        std::unique_ptr<uchar[]> storage;
+        uchar *data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks_;
+    size_t block_ = 0, offset_ = 0, used_ = 0, peak_ = 0;
+    std::atomic<size_t> capacity_{0};
+};
+
+// One arena per concurrently running request, created on first use.
+class ScratchPool {
+public:
+    class Lease {
+    public:
+        explicit Lease(ScratchPool &pool) : pool_(pool), arena_(pool.Acquire()) {}
+        ~Lease() { pool_.Release(arena_); }
+        ScratchArena* operator->() const { return arena_; }
+        ScratchArena &operator*() const { return *arena_; }
+
+    private:
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        ScratchPool &pool_;
+        ScratchArena *arena_;
+    };
+
+    size_t Capacity() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t total = 0;
+        for (auto &arena : arenas_) total += arena->Capacity();
+        return total;
+    }
+
+    // Frees the arenas that no request is using right now
+    size_t Trim() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t freed = 0;
+        for (ScratchArena *arena : idle_) freed += arena->Trim();
+        return freed;
+    }
+
+private:
+    ScratchArena* Acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.empty()) {
+            arenas_.emplace_back(new ScratchArena());
+            return arenas_.back().get();
         }
+        ScratchArena *arena = idle_.back();
+        idle_.pop_back();
+        return arena;
+    }
+
+    void Release(ScratchArena *arena) {
+        arena->Reset();
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back(arena);
     }
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ScratchArena>> arenas_;
+    std::vector<ScratchArena*> idle_;
 };
 
 // --- Postprocessing ---
+// A text box as four corners. Detection outputs them clockwise from the
+// top-left; boxes are stored contiguously as std::vector<Quad>.
+struct Quad {
+    cv::Point2f pts[4];
+
+    cv::Point2f &operator[](int i) { return pts[i]; }
+    const cv::Point2f &operator[](int i) const { return pts[i]; }
+};
+
+// Mean of the probability map inside a convex quad. The map's integral image
+// is built once; each box is then scored by walking its rows and summing the
+// covered span of every row in O(1), without rendering a mask.
+class BoxScorer {
+public:
+    // The integral image lives in `arena` until the arena is rewound
+    BoxScorer(const cv::Mat &pred, ScratchArena &arena)
+            : integral_(arena.Mat(pred.rows + 1, pred.cols + 1, CV_64F)), width_(pred.cols), height_(pred.rows) {
+        cv::integral(pred, integral_, CV_64F);
+    }
+
+    float Score(const Quad &box) const {
+        int px[4], py[4];
+        for (int i = 0; i < 4; i++) {
+            px[i] = (int)box[i].x;
+            py[i] = (int)box[i].y;
+        }
+        int ymin = std::max(0, *std::min_element(py, py + 4));
+        int ymax = std::min(height_ - 1, *std::max_element(py, py + 4));
+        double sum = 0;
+        long count = 0;
+        for (int y = ymin; y <= ymax; y++) {
+            float xl = std::numeric_limits<float>::max(), xr = -xl;
+            for (int i = 0; i < 4; i++) {
+                int j = (i + 1) % 4;
+                if (y < std::min(py[i], py[j]) || y > std::max(py[i], py[j])) continue;
+                if (py[i] == py[j]) {
+                    xl = std::min(xl, (float)std::min(px[i], px[j]));
+                    xr = std::max(xr, (float)std::max(px[i], px[j]));
+                } else {
+                    float x = px[i] + float(y - py[i]) * (px[j] - px[i]) / (py[j] - py[i]);
+                    xl = std::min(xl, x);
+                    xr = std::max(xr, x);
+                }
+            }
+            int x0 = std::max(0, (int)ceilf(xl - 1e-3f));
+            int x1 = std::min(width_ - 1, (int)floorf(xr + 1e-3f));
+            if (x0 > x1) continue;
+            const double *top = integral_.ptr<double>(y);
+            const double *bottom = integral_.ptr<double>(y + 1);
+            sum += (bottom[x1 + 1] - top[x1 + 1]) - (bottom[x0] - top[x0]);
+            count += x1 - x0 + 1;
+        }
+        return count > 0 ? float(sum / count) : 0.f;
+    }
+
+private:
+    cv::Mat integral_;
+    int width_, height_;
+};
+
 class DBPostProcessor {
 public:
-    static std::vector<std::vector<int>> OrderPointsClockwise(std::vector<std::vector<int>> pts) {
-        std::vector<std::vector<int>> box = pts;
-        std::sort(box.begin(), box.end(), [](const std::vector<int> &a, const std::vector<int> &b) {
-            return a[0] < b[0];
+    // Fused probability map -> 0/255 bitmap in one pass: bitmap = pred > thresh.
+    // With `dilate`, also applies the 2x2 dilation DB models are trained with,
+    // reading the map only once. `pred` may alias predictor output memory.
+    static void Binarize(const cv::Mat &pred, float thresh, bool dilate, cv::Mat &bitmap) {
+        int rows = pred.rows;
+        int cols = pred.cols;
+        // Undilated current and previous rows; row -1 and column -1 read as zero
+        std::vector<uchar> line(dilate ? 2 * (cols + 1) : 0, 0);
+        uchar *cur = dilate ? &line[1] : nullptr;
+        uchar *prev = dilate ? &line[cols + 2] : nullptr;
+#if CV_SIMD128
+        cv::v_float32x4 vt = cv::v_setall_f32(thresh);
+#endif
+        for (int h = 0; h < rows; h++) {
+            const float *src = pred.ptr<float>(h);
+            uchar *out = bitmap.ptr<uchar>(h);
+            uchar *dst = dilate ? cur : out;
+            int w = 0;
+#if CV_SIMD128
+            for (; w <= cols - 16; w += 16) {
+                cv::v_uint32x4 m[4];
+                for (int j = 0; j < 4; j++) {
+                    // v_gt() only exists since OpenCV 4.9; older releases
+                    // (the 4.5.5 Android SDK) only have the operator form
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 9)
+                    cv::v_float32x4 gt = cv::v_gt(cv::v_load(src + w + j * 4), vt);
+#else
+                    cv::v_float32x4 gt = cv::v_load(src + w + j * 4) > vt;
+#endif
+                    m[j] = cv::v_reinterpret_as_u32(gt);
+                }
+                // All-ones lanes saturate to 255, zero lanes stay 0
+                cv::v_store(dst + w, cv::v_pack(cv::v_pack(m[0], m[1]), cv::v_pack(m[2], m[3])));
+            }
+#endif
+            for (; w < cols; w++) {
+                dst[w] = src[w] > thresh ? 255 : 0;
+            }
+            if (!dilate) continue;
+
+            w = 0;
+#if CV_SIMD128
+            for (; w <= cols - 16; w += 16) {
+                cv::v_uint8x16 a = cv::v_max(cv::v_load(cur + w), cv::v_load(cur + w - 1));
+                cv::v_uint8x16 b = cv::v_max(cv::v_load(prev + w), cv::v_load(prev + w - 1));
+                cv::v_store(out + w, cv::v_max(a, b));
+            }
+#endif
+            for (; w < cols; w++) {
+                out[w] = std::max(std::max(cur[w], cur[w - 1]), std::max(prev[w], prev[w - 1]));
+            }
+            std::swap(cur, prev);
+        }
+    }
+
+    static Quad OrderPointsClockwise(const Quad &pts) {
+        Quad box = pts;
+        std::sort(box.pts, box.pts + 4, [](const cv::Point2f &a, const cv::Point2f &b) {
+            return a.x < b.x;
         });
-        std::vector<std::vector<int>> leftmost = {box[0], box[1]};
-        std::vector<std::vector<int>> rightmost = {box[2], box[3]};
-        if (leftmost[0][1] > leftmost[1][1]) std::swap(leftmost[0], leftmost[1]);
-        if (rightmost[0][1] > rightmost[1][1]) std::swap(rightmost[0], rightmost[1]);
-        return {leftmost[0], rightmost[0], rightmost[1], leftmost[1]};
+        cv::Point2f leftmost[2] = {box[0], box[1]};
+        cv::Point2f rightmost[2] = {box[2], box[3]};
+        if (leftmost[0].y > leftmost[1].y) std::swap(leftmost[0], leftmost[1]);
+        if (rightmost[0].y > rightmost[1].y) std::swap(rightmost[0], rightmost[1]);
+        return {{leftmost[0], rightmost[0], rightmost[1], leftmost[1]}};
     }
 
-    static std::vector<std::vector<float>> GetMiniBoxes(cv::RotatedRect box, float &ssid) {
+    static Quad GetMiniBoxes(const cv::RotatedRect &box, float &ssid) {
         ssid = std::max(box.size.width, box.size.height);
-        cv::Mat points;
-        cv::boxPoints(box, points);
-        std::vector<std::vector<float>> array;
+        Quad array;
+        box.points(array.pts);
+        std::sort(array.pts, array.pts + 4, [](const cv::Point2f &a, const cv::Point2f &b) {
+            return a.x < b.x;
+        });
+        cv::Point2f idx1, idx2, idx3, idx4;
+        if (array[3].y <= array[2].y) { idx2 = array[3]; idx3 = array[2]; } else { idx2 = array[2]; idx3 = array[3]; }
+        if (array[1].y <= array[0].y) { idx1 = array[1]; idx4 = array[0]; } else { idx1 = array[0]; idx4 = array[1]; }
+        return {{idx1, idx2, idx3, idx4}};
+    }
+
+    // Turns one contour into an unclipped, clockwise box. Returns false if the
+    // contour is too small or scores below box_thresh. The unclip is closed
+    // form unless polygon_unclip asks for the general ClipperOffset path.
+    static bool BoxFromContour(const std::vector<cv::Point> &contour, const BoxScorer &scorer, const cv::Size &size,
+                               float box_thresh, float unclip_ratio, bool polygon_unclip,
+                               ClipperLib::ClipperOffset &offset, Quad &out) {
+        if (contour.size() <= 2) return false;
+        float ssid;
+        cv::RotatedRect rect = cv::minAreaRect(contour);
+        auto box = GetMiniBoxes(rect, ssid);
+        if (ssid < 3) return false;
+        if (scorer.Score(box) < box_thresh) return false;
+
+        // Unclip
+        float area = 0, dist = 0;
         for (int i = 0; i < 4; i++) {
-            array.push_back({points.at<float>(i, 0), points.at<float>(i, 1)});
+            area += box[i].x * box[(i + 1) % 4].y - box[i].y * box[(i + 1) % 4].x;
+            dist += sqrtf(powf(box[i].x - box[(i + 1) % 4].x, 2) + powf(box[i].y - box[(i + 1) % 4].y, 2));
         }
-        std::sort(array.begin(), array.end(), [](const std::vector<float> &a, const std::vector<float> &b) {
-            return a[0] < b[0];
-        });
-        std::vector<float> idx1, idx2, idx3, idx4;
-        if (array[3][1] <= array[2][1]) { idx2 = array[3]; idx3 = array[2]; } else { idx2 = array[2]; idx3 = array[3]; }
-        if (array[1][1] <= array[0][1]) { idx1 = array[1]; idx4 = array[0]; } else { idx1 = array[0]; idx4 = array[1]; }
-        return {idx1, idx2, idx3, idx4};
-    }
-
-    static float BoxScoreFast(const std::vector<std::vector<float>> &box, const cv::Mat &pred) {
-        int width = pred.cols;
-        int height = pred.rows;
-        float box_x[4] = {box[0][0], box[1][0], box[2][0], box[3][0]};
-        float box_y[4] = {box[0][1], box[1][1], box[2][1], box[3][1]};
-        int xmin = std::max(0, (int)floor(*std::min_element(box_x, box_x + 4)));
-        int xmax = std::min(width - 1, (int)ceil(*std::max_element(box_x, box_x + 4)));
-        int ymin = std::max(0, (int)floor(*std::min_element(box_y, box_y + 4)));
-        int ymax = std::min(height - 1, (int)ceil(*std::max_element(box_y, box_y + 4)));
-        cv::Mat mask = cv::Mat::zeros(ymax - ymin + 1, xmax - xmin + 1, CV_8UC1);
-        cv::Point rook_points[4];
-        for (int i = 0; i < 4; i++) rook_points[i] = cv::Point((int)box[i][0] - xmin, (int)box[i][1] - ymin);
-        const cv::Point *ppt[1] = {rook_points};
-        int npt[] = {4};
-        cv::fillPoly(mask, ppt, npt, 1, cv::Scalar(1));
-        return cv::mean(pred(cv::Rect(xmin, ymin, xmax - xmin + 1, ymax - ymin + 1)), mask)[0];
-    }
-
-    static std::vector<std::vector<std::vector<int>>> BoxesFromBitmap(const cv::Mat &pred, const cv::Mat &bitmap, float box_thresh, float unclip_ratio) {
-        std::vector<std::vector<cv::Point>> contours;
-        cv::findContours(bitmap, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
-        std::vector<std::vector<std::vector<int>>> boxes;
-        for (auto &contour : contours) {
-            if (contour.size() <= 2) continue;
-            float ssid;
-            cv::RotatedRect rect = cv::minAreaRect(contour);
-            auto box = GetMiniBoxes(rect, ssid);
-            if (ssid < 3) continue;
-            if (BoxScoreFast(box, pred) < box_thresh) continue;
-            
-            // Unclip
-            float area = 0, dist = 0;
-            for (int i = 0; i < 4; i++) {
-                area += box[i][0] * box[(i + 1) % 4][1] - box[i][1] * box[(i + 1) % 4][0];
-                dist += sqrtf(powf(box[i][0] - box[(i + 1) % 4][0], 2) + powf(box[i][1] - box[(i + 1) % 4][1], 2));
-            }
-            float distance = fabsf(area) * unclip_ratio / dist;
-            ClipperLib::ClipperOffset offset;
+        float distance = fabsf(area) * unclip_ratio / dist;
+        cv::RotatedRect unclip_rect;
+        if (polygon_unclip) {
+            offset.Clear();
             ClipperLib::Path p;
-            for (int i = 0; i < 4; i++) p << ClipperLib::IntPoint((int)box[i][0], (int)box[i][1]);
+            for (int i = 0; i < 4; i++) p << ClipperLib::IntPoint((int)box[i].x, (int)box[i].y);
             offset.AddPath(p, ClipperLib::jtRound, ClipperLib::etClosedPolygon);
             ClipperLib::Paths soln;
             offset.Execute(soln, distance);
-            if (soln.empty()) continue;
+            if (soln.empty()) return false;
             std::vector<cv::Point2f> points;
             for (auto &pt : soln[0]) points.emplace_back(pt.X, pt.Y);
-            cv::RotatedRect unclip_rect = cv::minAreaRect(points);
-            auto unclip_box = GetMiniBoxes(unclip_rect, ssid);
-            if (ssid < 5) continue;
-            
-            std::vector<std::vector<int>> int_box;
-            for (int i = 0; i < 4; i++) {
-                int_box.push_back({(int)Utility::clamp(roundf(unclip_box[i][0]), 0, (float)pred.cols),
-                                   (int)Utility::clamp(roundf(unclip_box[i][1]), 0, (float)pred.rows)});
+            unclip_rect = cv::minAreaRect(points);
+        } else {
+            // The min-area rect of a rectangle offset by d with round joins is
+            // the same rectangle grown by d on every side
+            unclip_rect = cv::RotatedRect(rect.center, cv::Size2f(rect.size.width + 2 * distance,
+                                                                  rect.size.height + 2 * distance), rect.angle);
+        }
+        auto unclip_box = GetMiniBoxes(unclip_rect, ssid);
+        if (ssid < 5) return false;
+
+        for (int i = 0; i < 4; i++) {
+            unclip_box[i].x = Utility::clamp(roundf(unclip_box[i].x), 0, (float)size.width);
+            unclip_box[i].y = Utility::clamp(roundf(unclip_box[i].y), 0, (float)size.height);
+        }
+        out = OrderPointsClockwise(unclip_box);
+        return true;
+    }
+
+    // With threads > 1 the contour list is split into stripes on OpenCV's
+    // thread pool; each stripe reuses its own ClipperOffset. Results land in
+    // per-contour slots, so the output order matches the serial path.
+    static std::vector<Quad> BoxesFromBitmap(const cv::Mat &pred, const cv::Mat &bitmap, ScratchArena &arena,
+                                             float box_thresh, float unclip_ratio, bool polygon_unclip = false,
+                                             int threads = 1) {
+        std::vector<std::vector<cv::Point>> contours;
+        cv::findContours(bitmap, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+        BoxScorer scorer(pred, arena);
+        std::vector<Quad> slots(contours.size());
+        std::vector<char> found(contours.size(), 0);
+        auto body = [&](const cv::Range &range) {
+            ClipperLib::ClipperOffset offset;
+            for (int i = range.start; i < range.end; i++) {
+                found[i] = BoxFromContour(contours[i], scorer, pred.size(), box_thresh, unclip_ratio, polygon_unclip,
+                                          offset, slots[i]);
             }
-            boxes.push_back(OrderPointsClockwise(int_box));
+        };
+        const int min_contours_per_stripe = 32;
+        int stripes = std::min(threads, (int)contours.size() / min_contours_per_stripe);
+        if (stripes > 1) {
+            cv::parallel_for_(cv::Range(0, (int)contours.size()), body, stripes);
+        } else {
+            body(cv::Range(0, (int)contours.size()));
+        }
+
+        std::vector<Quad> boxes;
+        for (size_t i = 0; i < contours.size(); i++) {
+            if (found[i]) boxes.push_back(slots[i]);
         }
         return boxes;
     }
+
+    // Joins boxes from different tiles whose bounding rects overlap by at
+    // least half of the smaller box's extent across the text direction (its
+    // height, or its width when both boxes are vertical), i.e. pieces of one
+    // line cut by a tile border or a line detected twice in an overlap.
+    // Stacked lines that merely touch are kept apart. Only boxes reaching into
+    // a band where `tiles` overlap or meet can merge, so only those are
+    // compared, sweeping them in order of their top edge.
+    static std::vector<Quad> MergeTileBoxes(const std::vector<std::vector<Quad>> &tile_boxes,
+                                            const std::vector<cv::Rect> &tiles) {
+        std::vector<Quad> boxes;
+        std::vector<int> tile_of;
+        std::vector<cv::Rect> rects;
+        for (size_t t = 0; t < tile_boxes.size(); t++) {
+            for (auto &box : tile_boxes[t]) {
+                boxes.push_back(box);
+                tile_of.push_back((int)t);
+                rects.push_back(cv::boundingRect(std::vector<cv::Point2f>(box.pts, box.pts + 4)));
+            }
+        }
+
+        // Seam bands, grown by a pixel so tiles without overlap still meet
+        std::vector<cv::Rect> bands;
+        for (size_t t = 0; t < tiles.size(); t++) {
+            for (size_t u = t + 1; u < tiles.size(); u++) {
+                cv::Rect a(tiles[t].x - 1, tiles[t].y - 1, tiles[t].width + 2, tiles[t].height + 2);
+                cv::Rect b(tiles[u].x - 1, tiles[u].y - 1, tiles[u].width + 2, tiles[u].height + 2);
+                cv::Rect band = a & b;
+                if (band.width > 0 && band.height > 0) bands.push_back(band);
+            }
+        }
+        std::vector<int> candidates;
+        for (size_t i = 0; i < boxes.size(); i++) {
+            for (auto &band : bands) {
+                cv::Rect hit = rects[i] & band;
+                if (hit.width > 0 && hit.height > 0) {
+                    candidates.push_back((int)i);
+                    break;
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [&rects](int a, int b) { return rects[a].y < rects[b].y; });
+
+        std::vector<int> parent(boxes.size());
+        std::iota(parent.begin(), parent.end(), 0);
+        std::function<int(int)> find = [&](int i) { return parent[i] == i ? i : parent[i] = find(parent[i]); };
+        for (size_t ci = 0; ci < candidates.size(); ci++) {
+            int i = candidates[ci];
+            for (size_t cj = ci + 1; cj < candidates.size(); cj++) {
+                int j = candidates[cj];
+                if (rects[j].y >= rects[i].y + rects[i].height) break;
+                if (tile_of[i] == tile_of[j]) continue;
+                const cv::Rect &a = rects[i], &b = rects[j];
+                int ox = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+                int oy = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+                if (ox <= 0 || oy <= 0) continue;
+                bool vertical = a.height >= a.width * 1.5 && b.height >= b.width * 1.5;
+                bool same_line = vertical ? ox * 2 >= std::min(a.width, b.width)
+                                          : oy * 2 >= std::min(a.height, b.height);
+                if (same_line) {
+                    parent[find(i)] = find(j);
+                }
+            }
+        }
+
+        std::vector<std::vector<cv::Point2f>> groups(boxes.size());
+        for (size_t i = 0; i < boxes.size(); i++) {
+            groups[find((int)i)].insert(groups[find((int)i)].end(), boxes[i].pts, boxes[i].pts + 4);
+        }
+        std::vector<Quad> merged;
+        for (size_t i = 0; i < boxes.size(); i++) {
+            if (groups[i].empty()) continue;
+            if (groups[i].size() == 4) {
+                merged.push_back(boxes[i]);
+                continue;
+            }
+            float ssid;
+            Quad box = GetMiniBoxes(cv::minAreaRect(groups[i]), ssid);
+            for (int k = 0; k < 4; k++) box[k] = cv::Point2f(roundf(box[k].x), roundf(box[k].y));
+            merged.push_back(OrderPointsClockwise(box));
+        }
+        return merged;
+    }
+};
+
+// Greedy argmax of each time step of one rec output row
+struct RecSequence {
+    std::vector<int> index;
+    std::vector<float> prob;
+    float step_width = 0;  // Input pixels covered by one time step
+};
+
+// --- Predictor Pool ---
+#ifdef WITH_LITE
+typedef std::shared_ptr<PaddlePredictor> PredictorPtr;
+#else
+typedef std::shared_ptr<Predictor> PredictorPtr;
+#endif
+
+// Holds a fixed set of predictors for one model. Each predictor owns its
+// tensors, so each concurrent Run borrows one exclusively through a Lease.
+// Paddle Inference clones share the prototype's weights; Lite predictors
+// each load their own copy of the model.
+class PredictorPool {
+public:
+    class Lease {
+    public:
+        explicit Lease(PredictorPool &pool) : pool_(pool), predictor_(pool.Acquire()) {}
+        ~Lease() { pool_.Release(predictor_); }
+        PredictorPtr::element_type* operator->() const { return predictor_.get(); }
+
+    private:
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        PredictorPool &pool_;
+        PredictorPtr predictor_;
+    };
+
+    void Add(const PredictorPtr &predictor) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back(predictor);
+    }
+
+private:
+    PredictorPtr Acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return !idle_.empty(); });
+        PredictorPtr predictor = idle_.back();
+        idle_.pop_back();
+        return predictor;
+    }
+
+    void Release(const PredictorPtr &predictor) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            idle_.push_back(predictor);
+        }
+        cond_.notify_one();
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<PredictorPtr> idle_;
+};
+
+// An image ready for detection. A reduced JPEG decode also carries its
+// scale to full resolution and a loader for the full-resolution image.
+struct DecodedImage {
+    SourceImage src;
+    int scale = 1;
+    std::function<cv::Mat()> load_full;
+};
+
+// --- Crop Pyramid ---
+// Half-resolution copies of a request's crop source, built on first use in
+// the request's arena. Level k is the base pyrDown'ed k times, so a point
+// (x, y) of the base lies at (x, y) / 2^k on it. A pyramid may also start
+// from a reduced decode at some level and load the base only if a crop
+// needs more detail than that level has.
+class ImagePyramid {
+public:
+    // `image` is level `level` of a base of size base_size; load_base is only
+    // called for levels below it
+    ImagePyramid(const cv::Mat &image, int level, const cv::Size &base_size,
+                 const std::function<cv::Mat()> &load_base, ScratchArena &arena)
+            : arena_(arena), base_size_(base_size), load_base_(load_base), levels_(level + 1) {
+        levels_[level] = image;
+    }
+
+    const cv::Mat &Level(int k) {
+        if ((int)levels_.size() <= k) levels_.resize(k + 1);
+        if (levels_[k].empty()) {
+            if (k == 0) {
+                levels_[0] = load_base_();
+                if (levels_[0].empty()) throw std::runtime_error("cannot decode image");
+            } else {
+                const cv::Mat &prev = Level(k - 1);
+                cv::Mat next = arena_.Mat((prev.rows + 1) / 2, (prev.cols + 1) / 2, prev.type());
+                cv::pyrDown(prev, next, next.size());
+                levels_[k] = next;
+            }
+        }
+        return levels_[k];
+    }
+
+    // Restarts the pyramid from `base` as level 0, dropping all levels
+    void Reset(const cv::Mat &base) {
+        levels_.assign(1, base);
+        base_size_ = base.size();
+    }
+
+    // Deepest level on which text `text_h` base pixels high is still at
+    // least `min_h` pixels high
+    int LevelFor(float text_h, int min_h) const {
+        int k = 0;
+        int rows = base_size_.height, cols = base_size_.width;
+        while (text_h >= 2.f * min_h && rows > 1 && cols > 1) {
+            text_h *= 0.5f;
+            rows = (rows + 1) / 2;
+            cols = (cols + 1) / 2;
+            k++;
+        }
+        return k;
+    }
+
+private:
+    ScratchArena &arena_;
+    cv::Size base_size_;
+    std::function<cv::Mat()> load_base_;
+    std::vector<cv::Mat> levels_;
+};
+
+// --- Pipeline ---
+// Fixed-capacity FIFO between pipeline stages. Push blocks while the queue is
+// full; Pop blocks while it is empty and returns false once it is closed and
+// drained.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(1, capacity)) {}
+
+    void Push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this]() { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    bool Pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this]() { return !items_.empty() || closed_; });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    bool closed_ = false;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_full_, not_empty_;
+};
+
+// Shelf packer for detection mosaics: places rectangles left to right in
+// rows, `gap` pixels apart and away from the canvas edges.
+class MosaicPacker {
+public:
+    MosaicPacker(int side, int gap) : side_(side), gap_(gap) { Clear(); }
+
+    bool Place(const cv::Size &size, cv::Rect &cell) {
+        if (x_ + size.width + gap_ > side_) {
+            x_ = gap_;
+            y_ += shelf_h_ + gap_;
+            shelf_h_ = 0;
+        }
+        if (x_ + size.width + gap_ > side_ || y_ + size.height + gap_ > side_) return false;
+        cell = cv::Rect(x_, y_, size.width, size.height);
+        x_ += size.width + gap_;
+        shelf_h_ = std::max(shelf_h_, size.height);
+        used_.width = std::max(used_.width, x_);
+        used_.height = std::max(used_.height, y_ + shelf_h_ + gap_);
+        return true;
+    }
+
+    // Canvas covering every cell placed so far, in multiples of 32 so the
+    // detector runs it unscaled
+    cv::Size CanvasSize() const {
+        return cv::Size(std::min(side_, (used_.width + 31) / 32 * 32), std::min(side_, (used_.height + 31) / 32 * 32));
+    }
+
+    void Clear() {
+        x_ = y_ = gap_;
+        shelf_h_ = 0;
+        used_ = cv::Size(0, 0);
+    }
+
+private:
+    int side_, gap_;
+    int x_, y_, shelf_h_;
+    cv::Size used_;
+};
+
+// --- Rec Batching ---
+// Shares rec predictor runs between concurrent requests. Each caller queues
+// its crops and then helps flush: whoever finds a full batch queued, or the
+// oldest crop past its deadline, runs that batch in its own arena and routes
+// the sequences back to the owning callers, which stay blocked until all of
+// their crops are done (so the crops stay valid).
+class RecBatcher {
+public:
+    typedef std::function<std::vector<RecSequence>(const std::vector<cv::Mat> &, ScratchArena &)> BatchFn;
+
+    RecBatcher(size_t batch_size, int wait_us, const BatchFn &run_batch)
+            : batch_size_(std::max<size_t>(1, batch_size)), wait_(wait_us), run_batch_(run_batch) {}
+
+    std::vector<RecSequence> Run(const std::vector<cv::Mat> &crops, ScratchArena &arena) {
+        std::vector<RecSequence> sequences(crops.size());
+        Request request;
+        request.remaining = crops.size();
+        Clock::time_point deadline = Clock::now() + wait_;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < crops.size(); i++) pending_.push_back({&crops[i], &sequences[i], &request, deadline});
+        cond_.notify_all();
+        while (request.remaining > 0) {
+            if (!pending_.empty() && (pending_.size() >= batch_size_ || Clock::now() >= pending_.front().deadline)) {
+                size_t n = std::min(batch_size_, pending_.size());
+                std::vector<Item> batch(pending_.begin(), pending_.begin() + n);
+                pending_.erase(pending_.begin(), pending_.begin() + n);
+                lock.unlock();
+                std::vector<cv::Mat> images;
+                for (auto &item : batch) images.push_back(*item.crop);
+                std::vector<RecSequence> results;
+                bool ok = true;
+                try {
+                    results = run_batch_(images, arena);
+                } catch (...) {
+                    ok = false;
+                }
+                lock.lock();
+                for (size_t k = 0; k < batch.size(); k++) {
+                    if (ok) {
+                        batch[k].out->index.swap(results[k].index);
+                        batch[k].out->prob.swap(results[k].prob);
+                        batch[k].out->step_width = results[k].step_width;
+                    } else {
+                        batch[k].request->failed = true;
+                    }
+                    batch[k].request->remaining--;
+                }
+                cond_.notify_all();
+            } else if (pending_.empty()) {
+                // Our remaining crops are being run by other callers
+                cond_.wait(lock);
+            } else {
+                cond_.wait_until(lock, pending_.front().deadline);
+            }
+        }
+        if (request.failed) throw std::runtime_error("recognition failed");
+        return sequences;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Request {
+        size_t remaining = 0;
+        bool failed = false;
+    };
+
+    struct Item {
+        const cv::Mat *crop;
+        RecSequence *out;
+        Request *request;
+        Clock::time_point deadline;
+    };
+
+    size_t batch_size_;
+    std::chrono::microseconds wait_;
+    BatchFn run_batch_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Item> pending_;
 };
 
 // --- Main Analyzer ---
 class OCRAnalyzer {
 public:
-    OCRAnalyzer(const std::string &det_model_path, const std::string &rec_model_path, const std::string &keys_path) {
+    OCRAnalyzer(const std::string &det_model_path, const std::string &rec_model_path, const std::string &keys_path,
+                const ocr_engine_options &options) : engine_options(options) {
+        int concurrency = std::max(1, options.max_concurrency);
+        int threads = std::max(1, options.cpu_threads);
 #ifdef WITH_LITE
-        MobileConfig det_config;
-        det_config.set_model_from_file(det_model_path + "/model.nb");
-        det_predictor = CreatePaddlePredictor<MobileConfig>(det_config);
+        // The light API cannot Clone(), so extra predictors are built from one
+        // in-memory copy of the model file instead of re-reading it.
+        std::string det_model = Utility::ReadFile(det_model_path + "/model.nb");
+        std::string rec_model = Utility::ReadFile(rec_model_path + "/model.nb");
+        for (int i = 0; i < concurrency; i++) {
+            MobileConfig det_config;
+            det_config.set_model_from_buffer(det_model);
+            det_config.set_threads(threads);
+            det_pool.Add(CreatePaddlePredictor<MobileConfig>(det_config));
 
-        MobileConfig rec_config;
-        rec_config.set_model_from_file(rec_model_path + "/model.nb");
-        rec_predictor = CreatePaddlePredictor<MobileConfig>(rec_config);
+            MobileConfig rec_config;
+            rec_config.set_model_from_buffer(rec_model);
+            rec_config.set_threads(threads);
+            rec_pool.Add(CreatePaddlePredictor<MobileConfig>(rec_config));
+        }
 #else
         Config det_config;
         det_config.SetModel(det_model_path + "/inference.pdmodel", det_model_path + "/inference.pdiparams");
         det_config.DisableGpu();
         det_config.EnableMKLDNN();
-        det_predictor = CreatePredictor(det_config);
+        det_config.SetCpuMathLibraryNumThreads(threads);
+        PredictorPtr det_predictor = CreatePredictor(det_config);
 
         Config rec_config;
         rec_config.SetModel(rec_model_path + "/inference.pdmodel", rec_model_path + "/inference.pdiparams");
         rec_config.DisableGpu();
         rec_config.EnableMKLDNN();
-        rec_predictor = CreatePredictor(rec_config);
+        rec_config.SetCpuMathLibraryNumThreads(threads);
+        PredictorPtr rec_predictor = CreatePredictor(rec_config);
+
+        // Clones share the parameter scope of the first predictor
+        det_pool.Add(det_predictor);
+        rec_pool.Add(rec_predictor);
+        for (int i = 1; i < concurrency; i++) {
+            det_pool.Add(PredictorPtr(det_predictor->Clone()));
+            rec_pool.Add(PredictorPtr(rec_predictor->Clone()));
+        }
 #endif
         label_list = Utility::ReadDict(keys_path);
         label_list.push_back(" ");
+
+        if (options.rec_batch_wait_us > 0) {
+            rec_batcher.reset(new RecBatcher(std::max(1, options.rec_batch_num), options.rec_batch_wait_us,
+                                             [this](const std::vector<cv::Mat> &crops, ScratchArena &arena) {
+                                                 return RecognizeBatches(crops, arena);
+                                             }));
+        }
     }
 
     std::string Run(const std::string &img_path) {
-#ifdef _WIN32
-        // Support Unicode paths on Windows
-        std::ifstream fs(img_path, std::ios::binary);
-        if (!fs) return "{\"error\":\"cannot open file stream\"}";
-        std::vector<unsigned char> data((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
-        cv::Mat img = cv::imdecode(data, cv::IMREAD_COLOR);
-#else
-        cv::Mat img = cv::imread(img_path, cv::IMREAD_COLOR);
-#endif
+        MappedFile file;
+        if (!file.Open(img_path)) return "{\"error\":\"cannot open file stream\"}";
+        return RunBuffer(file.Data(), file.Size());
+    }
+
+    std::string RunBuffer(const uint8_t *data, size_t len) {
+        DecodedImage image;
+        std::string error = Decode(data, len, image);
+        if (!error.empty()) return error;
+        return RunImage(image);
+    }
+
+    std::string RunPixels(const uint8_t *pixels, int width, int height, int stride, int format) {
+        DecodedImage image;
+        if (!SourceImage::Wrap(pixels, width, height, stride, format, image.src)) {
+            return "{\"error\":\"invalid pixel buffer\"}";
+        }
+        return RunImage(image);
+    }
+
+    // Runs the files as a three-stage pipeline: a decode thread, a detection
+    // thread and the calling thread recognizing, with at most kQueueDepth
+    // images waiting between stages. Image i+2 is decoded while i+1 is
+    // detected and i is recognized. Results are in the order of `paths`.
+    // With det_mosaic_size, small images are held back by the detection stage
+    // and detected together once a mosaic canvas is full.
+    std::vector<std::string> RunBatch(const std::vector<std::string> &paths) {
+        struct Job {
+            size_t index;
+            MappedFile file;
+            DecodedImage image;
+            std::unique_ptr<ScratchPool::Lease> scratch;
+            std::vector<Quad> boxes;
+            std::string error;
+            cv::Rect cell;
+        };
+        typedef std::unique_ptr<Job> JobPtr;
+        const size_t kQueueDepth = 2;
+        BoundedQueue<JobPtr> decoded(kQueueDepth), detected(kQueueDepth);
+        std::vector<std::string> results(paths.size());
+
+        std::thread decoder([&]() {
+            for (size_t i = 0; i < paths.size(); i++) {
+                JobPtr job(new Job());
+                job->index = i;
+                try {
+                    if (!job->file.Open(paths[i])) {
+                        job->error = "{\"error\":\"cannot open file stream\"}";
+                    } else {
+                        job->error = Decode(job->file.Data(), job->file.Size(), job->image);
+                    }
+                } catch (...) {
+                    job->error = "{\"error\":\"cannot decode image\"}";
+                }
+                decoded.Push(std::move(job));
+            }
+            decoded.Close();
+        });
+        std::thread detector([&]() {
+            const int mosaic_side = engine_options.det_mosaic_size;
+            MosaicPacker packer(mosaic_side, kMosaicGap);
+            std::vector<JobPtr> mosaic;
+            auto flush_mosaic = [&]() {
+                if (mosaic.empty()) return;
+                std::vector<const cv::Mat*> images;
+                std::vector<cv::Rect> cells;
+                for (auto &job : mosaic) {
+                    images.push_back(&job->image.src.mat);
+                    cells.push_back(job->cell);
+                }
+                std::vector<std::vector<Quad>> boxes;
+                std::string error;
+                try {
+                    boxes = DetectMosaic(images, cells, packer.CanvasSize());
+                } catch (...) {
+                    error = "{\"error\":\"detection failed\"}";
+                }
+                for (size_t i = 0; i < mosaic.size(); i++) {
+                    JobPtr job = std::move(mosaic[i]);
+                    job->error = error;
+                    if (error.empty()) {
+                        job->boxes.swap(boxes[i]);
+                        job->scratch.reset(new ScratchPool::Lease(scratch_pool));
+                    }
+                    detected.Push(std::move(job));
+                }
+                mosaic.clear();
+                packer.Clear();
+            };
+
+            JobPtr job;
+            while (decoded.Pop(job)) {
+                const SourceImage &src = job->image.src;
+                if (job->error.empty() && mosaic_side > 0 && job->image.scale == 1 &&
+                    std::max(src.Cols(), src.Rows()) <= mosaic_side / 2 - kMosaicGap) {
+                    if (!packer.Place(cv::Size(src.Cols(), src.Rows()), job->cell)) {
+                        flush_mosaic();
+                        packer.Place(cv::Size(src.Cols(), src.Rows()), job->cell);
+                    }
+                    mosaic.push_back(std::move(job));
+                    continue;
+                }
+                if (job->error.empty()) {
+                    try {
+                        job->scratch.reset(new ScratchPool::Lease(scratch_pool));
+                        job->boxes = DetectImage(job->image.src, **job->scratch);
+                    } catch (...) {
+                        job->error = "{\"error\":\"detection failed\"}";
+                    }
+                }
+                detected.Push(std::move(job));
+            }
+            flush_mosaic();
+            detected.Close();
+        });
+
+        JobPtr job;
+        while (detected.Pop(job)) {
+            std::string &result = results[job->index];
+            if (!job->error.empty()) {
+                result = job->error;
+            } else {
+                try {
+                    result = RecognizeImage(job->image, job->boxes, **job->scratch);
+                } catch (...) {
+                    result = "{\"error\":\"recognition failed\"}";
+                }
+            }
+            // Returns the arena and unmaps the file before waiting for the next image
+            job.reset();
+        }
+        decoder.join();
+        detector.join();
+        return results;
+    }
+
+    std::string RunImage(const DecodedImage &image) {
+        ScratchPool::Lease scratch(scratch_pool);
+        std::vector<Quad> boxes = DetectImage(image.src, *scratch);
+        return RecognizeImage(image, boxes, *scratch);
+    }
+
+    // Decodes an encoded image held in memory. Large JPEGs are decoded at a
+    // reduced scale whose loader re-reads `data`, which must therefore stay
+    // valid until the image has been recognized. Returns an error JSON or "".
+    std::string Decode(const uint8_t *data, size_t len, DecodedImage &out) {
+        if (len == 0 || len > (size_t)INT_MAX) return "{\"error\":\"invalid buffer size\"}";
+        // Non-owning header over the caller's bytes; imdecode reads them in place
+        cv::Mat raw(1, (int)len, CV_8UC1, (void*)data);
+        int width, height;
+        int factor = Utility::JpegSize(data, len, width, height) ? ReducedDecodeFactor(width, height) : 1;
+        if (factor > 1) {
+            int flag = factor == 8 ? cv::IMREAD_REDUCED_COLOR_8 : factor == 4 ? cv::IMREAD_REDUCED_COLOR_4
+                                                                              : cv::IMREAD_REDUCED_COLOR_2;
+            cv::Mat reduced = cv::imdecode(raw, flag);
+            if (!reduced.empty()) {
+                out.src = SourceImage(reduced);
+                out.scale = factor;
+                out.load_full = [raw]() { return cv::imdecode(raw, cv::IMREAD_COLOR); };
+                return "";
+            }
+        }
+        cv::Mat img = cv::imdecode(raw, cv::IMREAD_COLOR);
         if (img.empty()) return "{\"error\":\"cannot decode image\"}";
+        out.src = SourceImage(img);
+        out.scale = 1;
+        out.load_full = nullptr;
+        return "";
+    }
+
+    // Detects several small BGR images with one predictor run: each is copied
+    // into its cell of a blank canvas, and every detected box goes to the
+    // image whose cell holds its centre, clipped and moved to that image.
+    std::vector<std::vector<Quad>> DetectMosaic(const std::vector<const cv::Mat*> &images,
+                                                const std::vector<cv::Rect> &cells, const cv::Size &canvas_size) {
+        ScratchPool::Lease scratch(scratch_pool);
+        cv::Mat canvas = scratch->Mat(canvas_size.height, canvas_size.width, CV_8UC3);
+        canvas.setTo(cv::Scalar(0, 0, 0));
+        for (size_t i = 0; i < images.size(); i++) images[i]->copyTo(canvas(cells[i]));
 
-        // 1. Detection
-        cv::Mat det_img;
+        std::vector<std::vector<Quad>> boxes(images.size());
+        for (auto &box : Detect(SourceImage(canvas), std::max(canvas.cols, canvas.rows), *scratch)) {
+            cv::Point2f center = (box[0] + box[1] + box[2] + box[3]) * 0.25f;
+            for (size_t i = 0; i < cells.size(); i++) {
+                const cv::Rect &cell = cells[i];
+                if (center.x < cell.x || center.y < cell.y || center.x >= cell.x + cell.width ||
+                    center.y >= cell.y + cell.height) {
+                    continue;
+                }
+                for (auto &pt : box.pts) {
+                    pt.x = Utility::clamp(pt.x - cell.x, 0, (float)cell.width);
+                    pt.y = Utility::clamp(pt.y - cell.y, 0, (float)cell.height);
+                }
+                boxes[i].push_back(box);
+                break;
+            }
+        }
+        return boxes;
+    }
+
+    std::vector<Quad> DetectImage(const SourceImage &src, ScratchArena &arena) {
+        int tile_size = engine_options.det_tile_size;
+        if (tile_size > 0 && std::max(src.Cols(), src.Rows()) > tile_size) {
+            return DetectTiled(src);
+        } else if (engine_options.det_cascade) {
+            return DetectCascade(src, arena);
+        }
+        return Detect(src, 960, arena);
+    }
+
+    // Crops and recognizes the boxes detected on image.src. For a reduced
+    // decode the boxes are scaled to full resolution, and crops come from
+    // the full image only when the reduced one is too small for their text.
+    std::string RecognizeImage(const DecodedImage &image, std::vector<Quad> &boxes, ScratchArena &arena) {
+        const SourceImage &src = image.src;
+        int level = 0;
+        while ((1 << level) < image.scale) level++;
+        cv::Size full_size(src.Cols() * image.scale, src.Rows() * image.scale);
+        ImagePyramid pyramid(boxes.empty() ? cv::Mat() : src.CropSource(), level, full_size, image.load_full, arena);
+        if (image.scale > 1) {
+            int needed = level;
+            for (auto &box : boxes) {
+                for (auto &pt : box.pts) pt *= (float)image.scale;
+                needed = std::min(needed, pyramid.LevelFor(CropTextHeight(box), kRecHeight));
+            }
+            // Some text is too small for the reduced decode: crop everything
+            // from one full decode rather than mixing in the reduced image
+            if (needed < level) {
+                cv::Mat full = image.load_full();
+                if (full.empty()) throw std::runtime_error("cannot decode image");
+                pyramid.Reset(full);
+            }
+        }
+        int crop_code = src.ToBGRCode();
+        std::vector<cv::Mat> crops(boxes.size());
+        for (size_t i = 0; i < boxes.size(); i++) {
+            crops[i] = GetRotateCropImage(pyramid, boxes[i], arena);
+            if (crop_code >= 0) {
+                cv::Mat bgr = arena.Mat(crops[i].rows, crops[i].cols, CV_8UC3);
+                cv::cvtColor(crops[i], bgr, crop_code);
+                crops[i] = bgr;
+            }
+        }
+        std::vector<std::string> texts = Recognize(crops, arena);
+
+        std::string result_json = "{\"lines\": [";
+        for (size_t i = 0; i < texts.size(); i++) {
+            result_json += "\"" + texts[i] + "\"" + (i == texts.size() - 1 ? "" : ",");
+        }
+        result_json += "]}";
+        return result_json;
+    }
+
+    // Detects text boxes on src resized to at most max_side, returned in src
+    // coordinates. If regions is given it also receives the bounding rects of
+    // all text blobs in the thresholded map, padded by `region_pad` map pixels.
+    std::vector<Quad> Detect(const SourceImage &src, int max_side, ScratchArena &arena,
+                                                      std::vector<cv::Rect> *regions = nullptr, int region_pad = 0) {
+        PredictorPool::Lease det_predictor(det_pool);
+        int det_w, det_h;
+        Preprocessor::DetResizeShape(src.Cols(), src.Rows(), max_side, det_w, det_h);
+        cv::Mat det_img = arena.Mat(det_h, det_w, CV_8UC3);
         float ratio_h, ratio_w;
-        Preprocessor::ResizeDet(img, det_img, 960, ratio_h, ratio_w);
-        Preprocessor::Normalize(&det_img, {0.485f, 0.456f, 0.406f}, {1/0.229f, 1/0.224f, 1/0.225f}, true);
-        std::vector<float> det_input(1 * 3 * det_img.rows * det_img.cols);
-        Preprocessor::Permute(&det_img, det_input.data());
+        Preprocessor::ResizeDet(src, det_img, max_side, ratio_h, ratio_w);
+        const float det_mean[3] = {0.485f, 0.456f, 0.406f};
+        const float det_scale[3] = {1/0.229f, 1/0.224f, 1/0.225f};
 
 #ifdef WITH_LITE
         auto det_in_t = det_predictor->GetInput(0);
         det_in_t->Resize({1, 3, det_img.rows, det_img.cols});
-        float* det_in_ptr = det_in_t->mutable_data<float>();
-        memcpy(det_in_ptr, det_input.data(), sizeof(float) * det_input.size());
+        Preprocessor::NormalizePermute(det_img, det_mean, det_scale, true, det_in_t->mutable_data<float>());
         det_predictor->Run();
         auto det_out_t = det_predictor->GetOutput(0);
         const float* det_out_ptr = det_out_t->data<float>();
         cv::Mat pred(det_out_t->shape()[2], det_out_t->shape()[3], CV_32F, (float*)det_out_ptr);
 #else
+        float* det_input = arena.Floats(1 * 3 * det_img.rows * det_img.cols);
+        Preprocessor::NormalizePermute(det_img, det_mean, det_scale, true, det_input);
         auto det_in_names = det_predictor->GetInputNames();
         auto det_in_t = det_predictor->GetInputHandle(det_in_names[0]);
-        det_in_t->Reshape({1, 3, det_img.rows, det_img.cols});
-        det_in_t->CopyFromCpu(det_input.data());
+        if (engine_options.zero_copy_tensors) {
+            det_in_t->ShareExternalData<float>(det_input, {1, 3, det_img.rows, det_img.cols}, PlaceType::kCPU);
+        } else {
+            det_in_t->Reshape({1, 3, det_img.rows, det_img.cols});
+            det_in_t->CopyFromCpu(det_input);
+        }
         det_predictor->Run();
         auto det_out_names = det_predictor->GetOutputNames();
         auto det_out_t = det_predictor->GetOutputHandle(det_out_names[0]);
         std::vector<int> det_out_shape = det_out_t->shape();
-        std::vector<float> det_out_data(det_out_shape[2] * det_out_shape[3]);
-        det_out_t->CopyToCpu(det_out_data.data());
-        cv::Mat pred(det_out_shape[2], det_out_shape[3], CV_32F, det_out_data.data());
+        cv::Mat pred;
+        if (engine_options.zero_copy_tensors) {
+            // Output memory stays owned by the predictor, which this call holds until it returns
+            PlaceType det_out_place;
+            int det_out_size;
+            float* det_out_ptr = det_out_t->data<float>(&det_out_place, &det_out_size);
+            pred = cv::Mat(det_out_shape[2], det_out_shape[3], CV_32F, det_out_ptr);
+        } else {
+            pred = arena.Mat(det_out_shape[2], det_out_shape[3], CV_32F);
+            det_out_t->CopyToCpu(pred.ptr<float>());
+        }
 #endif
 
-        cv::Mat bitmap;
-        cv::threshold(pred, bitmap, 0.3, 255, cv::THRESH_BINARY);
-        bitmap.convertTo(bitmap, CV_8U);
-        auto boxes = DBPostProcessor::BoxesFromBitmap(pred, bitmap, 0.5, 2.0);
+        cv::Mat bitmap = arena.Mat(pred.rows, pred.cols, CV_8U);
+        DBPostProcessor::Binarize(pred, 0.3f, engine_options.det_use_dilation != 0, bitmap);
+        auto boxes = DBPostProcessor::BoxesFromBitmap(pred, bitmap, arena, 0.5, 2.0, engine_options.det_polygon_unclip != 0,
+                                                      engine_options.postprocess_threads);
+
+        if (regions) {
+            std::vector<std::vector<cv::Point>> blobs;
+            cv::findContours(bitmap, blobs, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+            cv::Rect bounds(0, 0, src.Cols(), src.Rows());
+            for (auto &blob : blobs) {
+                cv::Rect r = cv::boundingRect(blob);
+                int x0 = (int)floorf((r.x - region_pad) / ratio_w);
+                int y0 = (int)floorf((r.y - region_pad) / ratio_h);
+                int x1 = (int)ceilf((r.x + r.width + region_pad) / ratio_w);
+                int y1 = (int)ceilf((r.y + r.height + region_pad) / ratio_h);
+                regions->push_back(cv::Rect(x0, y0, x1 - x0, y1 - y0) & bounds);
+            }
+        }
 
         // Scale boxes back
         for (auto &box : boxes) {
-            for (auto &pt : box) {
-                pt[0] = (int)(pt[0] / ratio_w);
-                pt[1] = (int)(pt[1] / ratio_h);
+            for (auto &pt : box.pts) {
+                pt.x = (float)(int)(pt.x / ratio_w);
+                pt.y = (float)(int)(pt.y / ratio_h);
             }
         }
 
-        // 2. Recognition
-        std::string result_json = "{\"lines\": [";
-        for (size_t i = 0; i < boxes.size(); i++) {
-            cv::Mat crop_img = GetRotateCropImage(img, boxes[i]);
-            cv::Mat rec_img;
-            Preprocessor::ResizeRec(crop_img, rec_img, 48, 320);
-            Preprocessor::Normalize(&rec_img, {0.5f, 0.5f, 0.5f}, {1/0.5f, 1/0.5f, 1/0.5f}, true);
-            std::vector<float> rec_input(1 * 3 * rec_img.rows * rec_img.cols);
-            Preprocessor::Permute(&rec_img, rec_input.data());
+        return boxes;
+    }
+
+    // Finds text blobs with a cheap det_coarse_size pass, then runs detection
+    // at the usual 960 px scale only inside those regions. A region in which
+    // the fine pass finds nothing keeps its coarse boxes. Falls back to one
+    // full pass when the regions cover most of the image.
+    std::vector<Quad> DetectCascade(const SourceImage &src, ScratchArena &arena) {
+        const int full_side = 960, region_pad = 4;
+        int coarse_side = std::max(32, engine_options.det_coarse_size);
+        int max_wh = std::max(src.Cols(), src.Rows());
+        if (max_wh <= coarse_side * 2) return Detect(src, full_side, arena);
+
+        std::vector<cv::Rect> regions;
+        ScratchArena::Mark mark = arena.GetMark();
+        auto coarse_boxes = Detect(src, coarse_side, arena, &regions, region_pad);
+        arena.Rewind(mark);
+
+        // Merge overlapping regions and align them for NV12 chroma planes
+        for (bool merged = true; merged;) {
+            merged = false;
+            for (size_t i = 0; i < regions.size() && !merged; i++) {
+                for (size_t j = i + 1; j < regions.size(); j++) {
+                    if ((regions[i] & regions[j]).area() > 0) {
+                        regions[i] |= regions[j];
+                        regions.erase(regions.begin() + j);
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+        }
+        double covered = 0;
+        for (auto &r : regions) {
+            int x0 = r.x & ~1, y0 = r.y & ~1;
+            int x1 = std::min(src.Cols(), (r.x + r.width + 1) & ~1);
+            int y1 = std::min(src.Rows(), (r.y + r.height + 1) & ~1);
+            r = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+            covered += r.area();
+        }
+        if (covered > 0.5 * src.Cols() * src.Rows()) return Detect(src, full_side, arena);
+
+        float scale = std::min(1.f, float(full_side) / float(max_wh));
+        std::vector<Quad> boxes;
+        for (auto &region : regions) {
+            if (region.empty()) continue;
+            int side = std::max(32, (int)ceilf(std::max(region.width, region.height) * scale));
+            mark = arena.GetMark();
+            auto fine = Detect(src.Region(region), side, arena);
+            arena.Rewind(mark);
+            if (fine.empty()) {
+                for (auto &box : coarse_boxes) {
+                    cv::Point center((int)(box[0].x + box[2].x) / 2, (int)(box[0].y + box[2].y) / 2);
+                    if (region.contains(center)) boxes.push_back(box);
+                }
+                continue;
+            }
+            for (auto &box : fine) {
+                for (auto &pt : box.pts) pt += cv::Point2f((float)region.x, (float)region.y);
+                boxes.push_back(box);
+            }
+        }
+        return boxes;
+    }
+
+    // Runs detection at native resolution on overlapping tiles of up to
+    // det_tile_size pixels, optionally on several threads, then merges the
+    // pieces of lines cut by tile seams. Each worker only holds one tile's
+    // buffers at a time.
+    std::vector<Quad> DetectTiled(const SourceImage &src) {
+        int tile = std::max(64, engine_options.det_tile_size) & ~1;
+        int overlap = std::max(0, std::min(engine_options.det_tile_overlap, tile / 2)) & ~1;
+        std::vector<cv::Rect> tiles;
+        for (int y = 0;; y += tile - overlap) {
+            int h = std::min(tile, src.Rows() - y);
+            for (int x = 0;; x += tile - overlap) {
+                int w = std::min(tile, src.Cols() - x);
+                tiles.push_back(cv::Rect(x, y, w, h));
+                if (x + w >= src.Cols()) break;
+            }
+            if (y + h >= src.Rows()) break;
+        }
+
+        // Every worker holds a det predictor while it runs, so more workers
+        // than the pool has predictors would only queue on the pool
+        int threads = std::min(engine_options.det_tile_threads, std::max(1, engine_options.max_concurrency));
+        std::vector<std::vector<Quad>> tile_boxes(tiles.size());
+        Utility::ParallelFor((int)tiles.size(), threads, [&](int i, int) {
+            ScratchPool::Lease scratch(scratch_pool);
+            auto boxes = Detect(src.Region(tiles[i]), tile, *scratch);
+            for (auto &box : boxes) {
+                for (auto &pt : box.pts) pt += cv::Point2f((float)tiles[i].x, (float)tiles[i].y);
+            }
+            tile_boxes[i].swap(boxes);
+        });
+        return DBPostProcessor::MergeTileBoxes(tile_boxes, tiles);
+    }
+
+    // Recognizes each crop. With rec_chunk_long_lines, crops wider than the
+    // rec input are cut into overlapping chunks that share the batched rec
+    // path; each chunk keeps the time steps nearest to its own centre and the
+    // concatenated steps are CTC-decoded as one line.
+    std::vector<std::string> Recognize(const std::vector<cv::Mat> &crops, ScratchArena &arena) {
+        const int rec_h = 48, rec_max_w = 320, chunk_overlap = 64;
+        struct Piece {
+            size_t crop;
+            float x0, keep_beg, keep_end;
+        };
+        std::vector<cv::Mat> images;
+        std::vector<Piece> pieces;
+        for (size_t i = 0; i < crops.size(); i++) {
+            int w = int(ceilf(float(rec_h) * float(crops[i].cols) / float(crops[i].rows)));
+            if (!engine_options.rec_chunk_long_lines || w <= rec_max_w) {
+                images.push_back(crops[i]);
+                pieces.push_back({i, 0.f, 0.f, std::numeric_limits<float>::max()});
+                continue;
+            }
+            cv::Mat line = crops[i];
+            if (line.rows != rec_h) {
+                line = arena.Mat(rec_h, w, CV_8UC3);
+                cv::resize(crops[i], line, cv::Size(w, rec_h), 0.f, 0.f, cv::INTER_LINEAR);
+            }
+            for (int x0 = 0;; x0 += rec_max_w - chunk_overlap) {
+                int cw = std::min(rec_max_w, w - x0);
+                bool last = x0 + cw >= w;
+                float keep_beg = x0 == 0 ? 0.f : x0 + chunk_overlap / 2.f;
+                float keep_end = last ? std::numeric_limits<float>::max() : x0 + cw - chunk_overlap / 2.f;
+                images.push_back(line.colRange(x0, x0 + cw));
+                pieces.push_back({i, (float)x0, keep_beg, keep_end});
+                if (last) break;
+            }
+        }
+
+        std::vector<RecSequence> sequences = rec_batcher ? rec_batcher->Run(images, arena)
+                                                         : RecognizeBatches(images, arena);
+        std::vector<RecSequence> lines(crops.size());
+        for (size_t p = 0; p < pieces.size(); p++) {
+            const Piece &piece = pieces[p];
+            const RecSequence &seq = sequences[p];
+            RecSequence &line = lines[piece.crop];
+            for (size_t t = 0; t < seq.index.size(); t++) {
+                float x = piece.x0 + (t + 0.5f) * seq.step_width;
+                if (x < piece.keep_beg || x >= piece.keep_end) continue;
+                line.index.push_back(seq.index[t]);
+                line.prob.push_back(seq.prob[t]);
+            }
+        }
+        std::vector<std::string> texts(crops.size());
+        for (size_t i = 0; i < lines.size(); i++) {
+            float score;
+            texts[i] = CTCDecode(lines[i], score);
+        }
+        return texts;
+    }
+
+    // Runs the rec predictor once per group of rec_batch_num crops with a
+    // {N, 3, 48, W} input and takes the per-step argmax of each row of the
+    // {N, T, C} output. W is 320, or with rec_dynamic_width the bucketed
+    // width of the widest crop in a batch of crops sorted by aspect ratio.
+    std::vector<RecSequence> RecognizeBatches(const std::vector<cv::Mat> &crops, ScratchArena &arena) {
+        static const int kWidthBuckets[] = {64, 128, 192, 256, 320};
+        const int rec_h = 48, rec_max_w = 320;
+        const size_t batch_num = std::max(1, engine_options.rec_batch_num);
+        std::vector<RecSequence> sequences(crops.size());
+        if (crops.empty()) return sequences;
+
+        std::vector<float> ratios(crops.size());
+        std::vector<size_t> order(crops.size());
+        for (size_t i = 0; i < crops.size(); i++) {
+            ratios[i] = float(crops[i].cols) / float(crops[i].rows);
+            order[i] = i;
+        }
+        if (engine_options.rec_dynamic_width) {
+            std::stable_sort(order.begin(), order.end(), [&ratios](size_t a, size_t b) {
+                return ratios[a] < ratios[b];
+            });
+        }
+
+        PredictorPool::Lease rec_predictor(rec_pool);
+        for (size_t beg = 0; beg < crops.size(); beg += batch_num) {
+            ScratchArena::Mark batch_mark = arena.GetMark();
+            int n = (int)std::min(batch_num, crops.size() - beg);
+            int rec_w = rec_max_w;
+            if (engine_options.rec_dynamic_width) {
+                float max_ratio = 0;
+                for (int k = 0; k < n; k++) max_ratio = std::max(max_ratio, ratios[order[beg + k]]);
+                int w = int(ceilf(float(rec_h) * max_ratio));
+                for (int bucket : kWidthBuckets) {
+                    rec_w = bucket;
+                    if (bucket >= w) break;
+                }
+            }
+            const size_t image_size = 3 * rec_h * rec_w;
+            const float rec_mean[3] = {0.5f, 0.5f, 0.5f};
+            const float rec_scale[3] = {1/0.5f, 1/0.5f, 1/0.5f};
 
 #ifdef WITH_LITE
             auto rec_in_t = rec_predictor->GetInput(0);
-            rec_in_t->Resize({1, 3, rec_img.rows, rec_img.cols});
-            float* rec_in_ptr = rec_in_t->mutable_data<float>();
-            memcpy(rec_in_ptr, rec_input.data(), sizeof(float) * rec_input.size());
+            rec_in_t->Resize({n, 3, rec_h, rec_w});
+            float* rec_input = rec_in_t->mutable_data<float>();
+#else
+            float* rec_input = arena.Floats(n * image_size);
+#endif
+            cv::Mat rec_img = arena.Mat(rec_h, rec_w, CV_8UC3);
+            for (int k = 0; k < n; k++) {
+                Preprocessor::ResizeRec(crops[order[beg + k]], rec_img, rec_h, rec_w);
+                Preprocessor::NormalizePermute(rec_img, rec_mean, rec_scale, true, rec_input + k * image_size);
+            }
+
+#ifdef WITH_LITE
             rec_predictor->Run();
             auto rec_out_t = rec_predictor->GetOutput(0);
             auto rec_shape = rec_out_t->shape();
             const float* rec_out_ptr = rec_out_t->data<float>();
-            std::vector<float> rec_out_data(std::accumulate(rec_shape.begin(), rec_shape.end(), 1, std::multiplies<int64_t>()));
-            memcpy(rec_out_data.data(), rec_out_ptr, sizeof(float) * rec_out_data.size());
 #else
             auto rec_in_names = rec_predictor->GetInputNames();
             auto rec_in_t = rec_predictor->GetInputHandle(rec_in_names[0]);
-            rec_in_t->Reshape({1, 3, rec_img.rows, rec_img.cols});
-            rec_in_t->CopyFromCpu(rec_input.data());
+            if (engine_options.zero_copy_tensors) {
+                rec_in_t->ShareExternalData<float>(rec_input, {n, 3, rec_h, rec_w}, PlaceType::kCPU);
+            } else {
+                rec_in_t->Reshape({n, 3, rec_h, rec_w});
+                rec_in_t->CopyFromCpu(rec_input);
+            }
             rec_predictor->Run();
             auto rec_out_names = rec_predictor->GetOutputNames();
             auto rec_out_t = rec_predictor->GetOutputHandle(rec_out_names[0]);
             auto rec_shape = rec_out_t->shape();
-            std::vector<float> rec_out_data(std::accumulate(rec_shape.begin(), rec_shape.end(), 1, std::multiplies<int>()));
-            rec_out_t->CopyToCpu(rec_out_data.data());
+            const float* rec_out_ptr;
+            if (engine_options.zero_copy_tensors) {
+                PlaceType rec_out_place;
+                int rec_out_size;
+                rec_out_ptr = rec_out_t->data<float>(&rec_out_place, &rec_out_size);
+            } else {
+                float* rec_out_data = arena.Floats(std::accumulate(rec_shape.begin(), rec_shape.end(), 1, std::multiplies<int>()));
+                rec_out_t->CopyToCpu(rec_out_data);
+                rec_out_ptr = rec_out_data;
+            }
 #endif
 
-            // CTC Decode
-            std::string text = "";
-            float score = 0;
-            int count = 0;
-            int last_idx = -1;
-            for (int n = 0; n < rec_shape[1]; n++) {
-                int argmax_idx = Utility::argmax(&rec_out_data[n * rec_shape[2]], &rec_out_data[(n + 1) * rec_shape[2]]);
-                float max_val = rec_out_data[n * rec_shape[2] + argmax_idx];
-                if (argmax_idx > 0 && argmax_idx < label_list.size() && argmax_idx != last_idx) {
-                    text += label_list[argmax_idx - 1];
-                    score += max_val;
-                    count++;
+            int steps = (int)rec_shape[1];
+            int classes = (int)rec_shape[2];
+            for (int k = 0; k < n; k++) {
+                RecSequence &seq = sequences[order[beg + k]];
+                const float *probs = rec_out_ptr + (size_t)k * steps * classes;
+                seq.index.resize(steps);
+                seq.prob.resize(steps);
+                seq.step_width = float(rec_w) / float(steps);
+                for (int t = 0; t < steps; t++) {
+                    seq.index[t] = Utility::argmax(&probs[t * classes], &probs[(t + 1) * classes]);
+                    seq.prob[t] = probs[t * classes + seq.index[t]];
                 }
-                last_idx = argmax_idx;
             }
-            if (count > 0) score /= count;
+            arena.Rewind(batch_mark);
+        }
+        return sequences;
+    }
 
-            result_json += "\"" + text + "\"" + (i == boxes.size() - 1 ? "" : ",");
+    std::string CTCDecode(const RecSequence &seq, float &score) const {
+        std::string text = "";
+        score = 0;
+        int count = 0;
+        int last_idx = -1;
+        for (size_t n = 0; n < seq.index.size(); n++) {
+            int argmax_idx = seq.index[n];
+            if (argmax_idx > 0 && argmax_idx < label_list.size() && argmax_idx != last_idx) {
+                text += label_list[argmax_idx - 1];
+                score += seq.prob[n];
+                count++;
+            }
+            last_idx = argmax_idx;
         }
-        result_json += "]}";
-        return result_json;
+        if (count > 0) score /= count;
+        return text;
     }
 
+    size_t ScratchBytes() { return scratch_pool.Capacity(); }
+
+    size_t TrimScratch() { return scratch_pool.Trim(); }
+
 private:
-#ifdef WITH_LITE
-    std::shared_ptr<PaddlePredictor> det_predictor;
-    std::shared_ptr<PaddlePredictor> rec_predictor;
-#else
-    std::shared_ptr<Predictor> det_predictor;
-    std::shared_ptr<Predictor> rec_predictor;
-#endif
+    // Blank pixels between mosaic cells, so no box spans two images
+    static const int kMosaicGap = 32;
+    // Height of the rec model input
+    static const int kRecHeight = 48;
+
+    ocr_engine_options engine_options;
+    PredictorPool det_pool;
+    PredictorPool rec_pool;
+    ScratchPool scratch_pool;
+    std::unique_ptr<RecBatcher> rec_batcher;
     std::vector<std::string> label_list;
 
-    cv::Mat GetRotateCropImage(const cv::Mat &src, const std::vector<std::vector<int>> &box) {
-        cv::Point2f pointsf[4];
-        for (int i = 0; i < 4; i++) pointsf[i] = cv::Point2f(box[i][0], box[i][1]);
-        int width = (int)sqrt(pow(box[0][0] - box[1][0], 2) + pow(box[0][1] - box[1][1], 2));
-        int height = (int)sqrt(pow(box[0][0] - box[3][0], 2) + pow(box[0][1] - box[3][1], 2));
-        cv::Point2f pts_std[4] = { {0,0}, {(float)width,0}, {(float)width,(float)height}, {0,(float)height} };
-        cv::Mat M = cv::getPerspectiveTransform(pointsf, pts_std);
-        cv::Mat dst;
-        cv::warpPerspective(src, dst, M, cv::Size(width, height), cv::BORDER_REPLICATE);
-        if (dst.rows >= dst.cols * 1.5) {
-            cv::transpose(dst, dst);
-            cv::flip(dst, dst, 0);
+    // Largest JPEG DCT scaling (2, 4 or 8) that keeps the default detection
+    // pass at full quality, or 1 unless det_reduced_decode is set. Tiling and
+    // the cascade detect at more than 960 px, so they always get the full decode.
+    int ReducedDecodeFactor(int width, int height) const {
+        const int det_side = 960;
+        int max_wh = std::max(width, height);
+        if (!engine_options.det_reduced_decode || engine_options.det_cascade) return 1;
+        if (engine_options.det_tile_size > 0 && max_wh > engine_options.det_tile_size) return 1;
+        int factor = 1;
+        while (factor < 8 && max_wh / (factor * 2) >= det_side) factor *= 2;
+        return factor;
+    }
+
+    // Height of the box's text once cropped upright (its width for vertical text)
+    static float CropTextHeight(const Quad &box) {
+        float width = sqrtf(powf(box[0].x - box[1].x, 2) + powf(box[0].y - box[1].y, 2));
+        float height = sqrtf(powf(box[0].x - box[3].x, 2) + powf(box[0].y - box[3].y, 2));
+        return (int)height >= (int)width * 1.5 ? width : height;
+    }
+
+    // Crops the box from the smallest pyramid level that still samples its
+    // text at no less than the rec input height.
+    cv::Mat GetRotateCropImage(ImagePyramid &pyramid, const Quad &box, ScratchArena &arena) {
+        int level = pyramid.LevelFor(CropTextHeight(box), kRecHeight);
+        if (level == 0) return GetRotateCropImage(pyramid.Level(0), box, arena);
+        float scale = 1.f / (1 << level);
+        Quad scaled = box;
+        for (auto &pt : scaled.pts) pt *= scale;
+        return GetRotateCropImage(pyramid.Level(level), scaled, arena);
+    }
+
+    // Warps the quad straight to the rec input height in one pass. Vertical
+    // text (height >= 1.5 * width) is turned 90 degrees counter-clockwise by
+    // the same transform, so no full-resolution intermediate crop is made.
+    cv::Mat GetRotateCropImage(const cv::Mat &src, const Quad &box, ScratchArena &arena) {
+        const int rec_h = 48;
+        int width = std::max(1, (int)sqrt(pow(box[0].x - box[1].x, 2) + pow(box[0].y - box[1].y, 2)));
+        int height = std::max(1, (int)sqrt(pow(box[0].x - box[3].x, 2) + pow(box[0].y - box[3].y, 2)));
+        bool vertical = height >= width * 1.5;
+        int crop_w = vertical ? height : width;
+        int crop_h = vertical ? width : height;
+        float w = (float)std::max(1, (int)ceilf(float(rec_h) * float(crop_w) / float(crop_h)));
+        float h = (float)rec_h;
+        cv::Point2f pts_std[4] = { {0,0}, {w,0}, {w,h}, {0,h} };
+        if (vertical) {
+            // Corners of the upright crop after transpose + vertical flip
+            cv::Point2f rotated[4] = { {0,h}, {0,0}, {w,0}, {w,h} };
+            std::copy(rotated, rotated + 4, pts_std);
         }
+        cv::Mat M = cv::getPerspectiveTransform(box.pts, pts_std);
+        cv::Mat dst = arena.Mat(rec_h, (int)w, src.type());
+        cv::warpPerspective(src, dst, M, dst.size(), cv::BORDER_REPLICATE);
         return dst;
     }
 };
 
+// --- Async Requests ---
+// Runs submitted requests on its own worker threads, one per concurrent
+// analyzer call, started by the first Submit. A finished request's result
+// waits in its ticket until Poll/Wait collects it, unless a callback was
+// given to receive it instead.
+class AsyncExecutor {
+public:
+    AsyncExecutor(const std::shared_ptr<OCRAnalyzer> &analyzer, int threads)
+            : analyzer_(analyzer), threads_(std::max(1, threads)) {}
+
+    // Runs the requests still queued, then stops the workers
+    ~AsyncExecutor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_cond_.notify_all();
+        for (auto &t : workers_) t.join();
+    }
+
+    uint64_t Submit(const ocr_input &input, ocr_callback callback, void *user_data) {
+        std::shared_ptr<Task> task = std::make_shared<Task>();
+        task->input = input;
+        if (input.type == OCR_INPUT_PATH) {
+            task->path = input.path;
+            task->input.path = task->path.c_str();
+        }
+        task->callback = callback;
+        task->user_data = user_data;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (workers_.empty()) {
+            for (int i = 0; i < threads_; i++) workers_.emplace_back(&AsyncExecutor::WorkerLoop, this);
+        }
+        task->ticket = next_ticket_++;
+        tasks_[task->ticket] = task;
+        queue_.push_back(task);
+        work_cond_.notify_one();
+        return task->ticket;
+    }
+
+    // 1: finished, result moved out and ticket released; 0: still running;
+    // -1: unknown ticket
+    int Poll(uint64_t ticket, std::string &result) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = tasks_.find(ticket);
+        if (it == tasks_.end()) return -1;
+        if (!it->second->done) return 0;
+        result.swap(it->second->result);
+        tasks_.erase(it);
+        return 1;
+    }
+
+    // Blocks until the ticket finishes; returns 1 and whether a result was
+    // collected (callback tickets hand theirs to the callback), or -1
+    int Wait(uint64_t ticket, std::string &result, bool &has_result) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = tasks_.find(ticket);
+        if (it == tasks_.end()) return -1;
+        std::shared_ptr<Task> task = it->second;
+        done_cond_.wait(lock, [&task]() { return task->done; });
+        has_result = !task->callback;
+        if (!has_result) return 1;
+        it = tasks_.find(ticket);
+        if (it == tasks_.end()) return -1;
+        result.swap(task->result);
+        tasks_.erase(it);
+        return 1;
+    }
+
+private:
+    struct Task {
+        uint64_t ticket = 0;
+        ocr_input input;
+        std::string path;
+        ocr_callback callback = nullptr;
+        void *user_data = nullptr;
+        std::string result;
+        bool done = false;
+    };
+
+    std::string Execute(const ocr_input &input) {
+        try {
+            switch (input.type) {
+                case OCR_INPUT_PATH:
+                    return analyzer_->Run(input.path);
+                case OCR_INPUT_BUFFER:
+                    if (!input.data) break;
+                    return analyzer_->RunBuffer(input.data, input.len);
+                case OCR_INPUT_PIXELS:
+                    return analyzer_->RunPixels(input.data, input.width, input.height, input.stride, input.format);
+                default:
+                    break;
+            }
+            return "{\"error\":\"invalid input\"}";
+        } catch (...) {
+            return "{\"error\":\"ocr failed\"}";
+        }
+    }
+
+    void WorkerLoop() {
+        for (;;) {
+            std::shared_ptr<Task> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_cond_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                task = queue_.front();
+                queue_.pop_front();
+            }
+            std::string result = Execute(task->input);
+            if (task->callback) task->callback(task->ticket, result.c_str(), task->user_data);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (task->callback) {
+                tasks_.erase(task->ticket);
+            } else {
+                task->result.swap(result);
+            }
+            task->done = true;
+            done_cond_.notify_all();
+        }
+    }
+
+    std::shared_ptr<OCRAnalyzer> analyzer_;
+    int threads_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_cond_, done_cond_;
+    std::deque<std::shared_ptr<Task>> queue_;
+    std::map<uint64_t, std::shared_ptr<Task>> tasks_;
+    uint64_t next_ticket_ = 1;
+    bool stopping_ = false;
+};
+
 } // namespace PaddleOCR
 
-static std::shared_ptr<PaddleOCR::OCRAnalyzer> g_analyzer;
+// An engine handle owns one analyzer. The analyzer hands each concurrent call
+// its own predictor, so a handle may be shared by up to max_concurrency threads.
+// The async executor is created with the handle; its workers are started
+// by the first ocr_engine_submit.
+struct ocr_engine {
+    std::shared_ptr<PaddleOCR::OCRAnalyzer> analyzer;
+    std::unique_ptr<PaddleOCR::AsyncExecutor> async;
+};
+
+static std::shared_ptr<ocr_engine> g_engine;
 static std::mutex g_ocr_mutex;
 
+static std::shared_ptr<ocr_engine> DefaultEngine() {
+    std::lock_guard<std::mutex> lock(g_ocr_mutex);
+    return g_engine;
+}
+
+static char* CopyResult(const std::string &result) {
+    char* c_res = (char*)malloc(result.length() + 1);
+    if (c_res) strcpy(c_res, result.c_str());
+    return c_res;
+}
+
 extern "C" {
 
-EXPORT int init_ocr_engine(const char* det_path, const char* rec_path, const char* keys_path) {
-    std::lock_guard<std::mutex> lock(g_ocr_mutex);
+EXPORT void ocr_engine_options_init(ocr_engine_options* options) {
+    if (!options) return;
+    options->max_concurrency = 1;
+    options->cpu_threads = 1;
+    options->rec_batch_num = 8;
+    options->rec_dynamic_width = 0;
+    options->rec_chunk_long_lines = 0;
+    options->zero_copy_tensors = 0;
+    options->postprocess_threads = 1;
+    options->det_polygon_unclip = 0;
+    options->det_use_dilation = 0;
+    options->rec_batch_wait_us = 0;
+    options->det_mosaic_size = 0;
+    options->det_reduced_decode = 0;
+    options->det_tile_size = 0;
+    options->det_tile_overlap = 128;
+    options->det_tile_threads = 1;
+    options->det_cascade = 0;
+    options->det_coarse_size = 320;
+}
+
+EXPORT ocr_engine* ocr_engine_create_with_options(const char* det_path, const char* rec_path, const char* keys_path,
+                                                  const ocr_engine_options* options) {
+    if (!det_path || !rec_path || !keys_path) return nullptr;
+    ocr_engine_options opts;
+    ocr_engine_options_init(&opts);
+    if (options) opts = *options;
     try {
-        g_analyzer = std::make_shared<PaddleOCR::OCRAnalyzer>(det_path, rec_path, keys_path);
-        return 1;
+        std::unique_ptr<ocr_engine> engine(new ocr_engine());
+        engine->analyzer = std::make_shared<PaddleOCR::OCRAnalyzer>(det_path, rec_path, keys_path, opts);
+        engine->async.reset(new PaddleOCR::AsyncExecutor(engine->analyzer, opts.max_concurrency));
+        return engine.release();
     } catch (const std::exception &e) {
         std::cerr << "OCR Init Failed: " << e.what() << std::endl;
+        return nullptr;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+EXPORT ocr_engine* ocr_engine_create(const char* det_path, const char* rec_path, const char* keys_path) {
+    return ocr_engine_create_with_options(det_path, rec_path, keys_path, nullptr);
+}
+
+EXPORT char* ocr_engine_run(ocr_engine* engine, const char* image_path) {
+    if (!engine || !engine->analyzer || !image_path) return nullptr;
+    try {
+        return CopyResult(engine->analyzer->Run(image_path));
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+EXPORT char* ocr_engine_run_buffer(ocr_engine* engine, const uint8_t* data, size_t len) {
+    if (!engine || !engine->analyzer || !data) return nullptr;
+    try {
+        return CopyResult(engine->analyzer->RunBuffer(data, len));
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+EXPORT char* ocr_engine_run_pixels(ocr_engine* engine, const uint8_t* pixels, int width, int height, int stride,
+                                   int format) {
+    if (!engine || !engine->analyzer || !pixels) return nullptr;
+    try {
+        return CopyResult(engine->analyzer->RunPixels(pixels, width, height, stride, format));
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+EXPORT int ocr_engine_run_batch(ocr_engine* engine, const char** image_paths, size_t count, char** results) {
+    if (!engine || !engine->analyzer || (count > 0 && (!image_paths || !results))) return 0;
+    for (size_t i = 0; i < count; i++) results[i] = nullptr;
+    try {
+        std::vector<std::string> paths(count);
+        for (size_t i = 0; i < count; i++) {
+            if (image_paths[i]) paths[i] = image_paths[i];
+        }
+        std::vector<std::string> texts = engine->analyzer->RunBatch(paths);
+        for (size_t i = 0; i < count; i++) results[i] = CopyResult(texts[i]);
+        return 1;
+    } catch (...) {
+        for (size_t i = 0; i < count; i++) {
+            free(results[i]);
+            results[i] = nullptr;
+        }
         return 0;
+    }
+}
+
+EXPORT uint64_t ocr_engine_submit(ocr_engine* engine, const ocr_input* input, ocr_callback callback, void* user_data) {
+    if (!engine || !engine->async || !input) return 0;
+    if (input->type == OCR_INPUT_PATH && !input->path) return 0;
+    try {
+        return engine->async->Submit(*input, callback, user_data);
     } catch (...) {
         return 0;
     }
 }
 
-EXPORT char* perform_ocr(const char* image_path) {
-    std::lock_guard<std::mutex> lock(g_ocr_mutex);
-    if (!g_analyzer) return nullptr;
+EXPORT int ocr_engine_poll(ocr_engine* engine, uint64_t ticket, char** result) {
+    if (!engine || !engine->async) return -1;
+    if (result) *result = nullptr;
     try {
-        std::string result = g_analyzer->Run(image_path);
-        char* c_res = (char*)malloc(result.length() + 1);
-        if (c_res) strcpy(c_res, result.c_str());
-        return c_res;
+        std::string text;
+        int status = engine->async->Poll(ticket, text);
+        if (status == 1 && result) *result = CopyResult(text);
+        return status;
     } catch (...) {
-        return nullptr;
+        return -1;
+    }
+}
+
+EXPORT int ocr_engine_wait(ocr_engine* engine, uint64_t ticket, char** result) {
+    if (!engine || !engine->async) return -1;
+    if (result) *result = nullptr;
+    try {
+        std::string text;
+        bool has_result = false;
+        int status = engine->async->Wait(ticket, text, has_result);
+        if (status == 1 && has_result && result) *result = CopyResult(text);
+        return status;
+    } catch (...) {
+        return -1;
     }
 }
 
+EXPORT size_t ocr_engine_scratch_bytes(ocr_engine* engine) {
+    if (!engine || !engine->analyzer) return 0;
+    return engine->analyzer->ScratchBytes();
+}
+
+EXPORT size_t ocr_engine_trim_scratch(ocr_engine* engine) {
+    if (!engine || !engine->analyzer) return 0;
+    return engine->analyzer->TrimScratch();
+}
+
+EXPORT void ocr_engine_destroy(ocr_engine* engine) {
+    delete engine;
+}
+
+EXPORT int init_ocr_engine(const char* det_path, const char* rec_path, const char* keys_path) {
+    ocr_engine* engine = ocr_engine_create(det_path, rec_path, keys_path);
+    if (!engine) return 0;
+    std::lock_guard<std::mutex> lock(g_ocr_mutex);
+    g_engine.reset(engine, ocr_engine_destroy);
+    return 1;
+}
+
+EXPORT char* perform_ocr(const char* image_path) {
+    std::shared_ptr<ocr_engine> engine = DefaultEngine();
+    if (!engine) return nullptr;
+    return ocr_engine_run(engine.get(), image_path);
+}
+
+EXPORT char* perform_ocr_from_buffer(const uint8_t* data, size_t len) {
+    std::shared_ptr<ocr_engine> engine = DefaultEngine();
+    if (!engine) return nullptr;
+    return ocr_engine_run_buffer(engine.get(), data, len);
+}
+
+EXPORT char* perform_ocr_from_pixels(const uint8_t* pixels, int width, int height, int stride, int format) {
+    std::shared_ptr<ocr_engine> engine = DefaultEngine();
+    if (!engine) return nullptr;
+    return ocr_engine_run_pixels(engine.get(), pixels, width, height, stride, format);
+}
+
+EXPORT int perform_ocr_batch(const char** image_paths, size_t count, char** results) {
+    std::shared_ptr<ocr_engine> engine = DefaultEngine();
+    if (!engine) return 0;
+    return ocr_engine_run_batch(engine.get(), image_paths, count, results);
+}
+
 EXPORT void free_ocr_result(char* result) {
     if (result) free(result);
 }
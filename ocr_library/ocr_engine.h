@@ -1,6 +1,9 @@
 #ifndef HOME_AI_OCR_ENGINE_H
 #define HOME_AI_OCR_ENGINE_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef _WIN32
 #define EXPORT __declspec(dllexport)
 #else
@@ -8,13 +11,146 @@
 #endif
 
 extern "C" {
-    // Initialize the OCR engine with model paths
+    // Opaque handle to an independent OCR engine instance
+    typedef struct ocr_engine ocr_engine;
+
+    // Pixel layouts accepted by the raw pixel entry points
+    enum ocr_pixel_format {
+        OCR_PIXEL_BGR = 0,
+        OCR_PIXEL_RGB = 1,
+        OCR_PIXEL_BGRA = 2,
+        OCR_PIXEL_RGBA = 3,
+        OCR_PIXEL_GRAY = 4,
+        OCR_PIXEL_NV12 = 5  // Y plane followed by the interleaved UV plane, both using `stride`
+    };
+
+    // Kinds of input an asynchronous request can carry
+    enum ocr_input_type {
+        OCR_INPUT_PATH = 0,    // path: image file
+        OCR_INPUT_BUFFER = 1,  // data/len: encoded image (JPEG/PNG/...)
+        OCR_INPUT_PIXELS = 2   // data/width/height/stride/format: decoded pixels
+    };
+
+    // Input of an asynchronous request. The path is copied on submit; data
+    // must stay valid until the request has finished.
+    typedef struct ocr_input {
+        int type;  // ocr_input_type
+        const char* path;
+        const uint8_t* data;
+        size_t len;
+        int width;
+        int height;
+        int stride;
+        int format;  // ocr_pixel_format
+    } ocr_input;
+
+    // Completion callback, run on a library worker thread. The result JSON is
+    // only valid during the call.
+    typedef void (*ocr_callback)(uint64_t ticket, const char* result, void* user_data);
+
+    // Engine creation options (fill defaults with ocr_engine_options_init)
+    typedef struct ocr_engine_options {
+        // Lite builds cannot share weights between predictors and keep one
+        // copy of the model per max_concurrency slot
+        int max_concurrency;       // Concurrent ocr_engine_run calls per handle; predictors share weights (default 1)
+        int cpu_threads;           // Math library threads per predictor (default 1)
+        int rec_batch_num;         // Text crops recognized per rec predictor run (default 8)
+        int rec_dynamic_width;     // Non-zero: batch crops by aspect ratio, pad only to the widest (default 0)
+        int rec_chunk_long_lines;  // Non-zero: split lines wider than the rec input into overlapping chunks (default 0)
+        int det_tile_size;         // >0: images larger than this are detected at full resolution in tiles of this size (default 0)
+        int det_tile_overlap;      // Overlap between neighbouring detection tiles in pixels (default 128)
+        // Each tile thread borrows one of the max_concurrency det predictors, so
+        // tiles run in parallel only up to max_concurrency, at the expense of
+        // other calls running on the same handle
+        int det_tile_threads;      // Threads detecting tiles, capped at max_concurrency (default 1)
+        int det_cascade;           // Non-zero: find text regions at det_coarse_size first, then detect only inside them (default 0)
+        int det_coarse_size;       // Long side of the coarse cascade pass (default 320)
+        int zero_copy_tensors;     // Non-zero: Paddle Inference shares input/output memory instead of copying (default 0)
+        int postprocess_threads;   // Threads turning detection contours into boxes (default 1)
+        int det_polygon_unclip;    // Non-zero: expand boxes with Clipper round offsets instead of the closed form (default 0)
+        int det_use_dilation;      // Non-zero: dilate the thresholded detection map by 2x2 before finding boxes (default 0)
+        int rec_batch_wait_us;     // >0: concurrent calls share rec batches; a partial batch waits this long for more crops (default 0)
+        int det_mosaic_size;       // >0: batch calls detect small images (under half this size) together on canvases of this size (default 0)
+        // Reduced decoding only pays off when text is tall: a line shorter than
+        // 48 px times the reduction makes the call decode the full image as well
+        int det_reduced_decode;    // Non-zero: detect large JPEGs on a 1/2-1/8 scale decode (default 0)
+    } ocr_engine_options;
+
+    // Fill options with default values
+    EXPORT void ocr_engine_options_init(ocr_engine_options* options);
+
+    // Create an OCR engine with its own detection/recognition predictors
+    // Returns nullptr on failure; release with ocr_engine_destroy
+    // Different handles can be used from different threads concurrently
+    EXPORT ocr_engine* ocr_engine_create(const char* det_path, const char* rec_path, const char* keys_path);
+
+    // Same as ocr_engine_create with explicit options (nullptr means defaults)
+    EXPORT ocr_engine* ocr_engine_create_with_options(const char* det_path, const char* rec_path, const char* keys_path,
+                                                      const ocr_engine_options* options);
+
+    // Perform OCR on an image file with the given engine
+    // Thread-safe: up to max_concurrency calls on one handle run in parallel
+    // Returns a JSON string of recognized results (must be freed with free_ocr_result)
+    EXPORT char* ocr_engine_run(ocr_engine* engine, const char* image_path);
+
+    // Perform OCR on an encoded image (JPEG/PNG/...) held in memory
+    // The bytes are decoded in place and only need to stay valid during the call
+    EXPORT char* ocr_engine_run_buffer(ocr_engine* engine, const uint8_t* data, size_t len);
+
+    // Perform OCR on decoded pixels in caller memory (no copy is made)
+    // stride is the row size in bytes (0 for tightly packed); format is an ocr_pixel_format
+    EXPORT char* ocr_engine_run_pixels(ocr_engine* engine, const uint8_t* pixels, int width, int height, int stride,
+                                       int format);
+
+    // Perform OCR on `count` image files as a pipeline that decodes, detects and
+    // recognizes consecutive images at the same time
+    // results[i] receives the JSON for image_paths[i] (free each with free_ocr_result)
+    // Returns 1 on success, 0 on failure (all results are then nullptr)
+    EXPORT int ocr_engine_run_batch(ocr_engine* engine, const char** image_paths, size_t count, char** results);
+
+    // Queue a request on the engine's worker threads (max_concurrency of them,
+    // started on first use) and return its ticket, or 0 on failure
+    // With a callback the result goes to the callback and the ticket is released
+    // when it returns; otherwise it is kept until collected with ocr_engine_poll
+    // or ocr_engine_wait
+    EXPORT uint64_t ocr_engine_submit(ocr_engine* engine, const ocr_input* input, ocr_callback callback,
+                                      void* user_data);
+
+    // Check a ticket without blocking: returns 1 when finished (the result is
+    // stored in *result, to be freed with free_ocr_result, and the ticket is
+    // released), 0 while still running, -1 for an unknown ticket
+    EXPORT int ocr_engine_poll(ocr_engine* engine, uint64_t ticket, char** result);
+
+    // Block until a ticket finishes; same return values as ocr_engine_poll
+    // (*result is nullptr for tickets submitted with a callback)
+    EXPORT int ocr_engine_wait(ocr_engine* engine, uint64_t ticket, char** result);
+
+    // Bytes held by the engine's reusable scratch buffers (kept at the high-water mark)
+    EXPORT size_t ocr_engine_scratch_bytes(ocr_engine* engine);
+
+    // Release scratch buffers not used by a running call; returns the bytes freed
+    EXPORT size_t ocr_engine_trim_scratch(ocr_engine* engine);
+
+    // Destroy an engine created by ocr_engine_create
+    // Requests already submitted are finished first
+    EXPORT void ocr_engine_destroy(ocr_engine* engine);
+
+    // Initialize the default OCR engine with model paths (wraps ocr_engine_create)
     EXPORT int init_ocr_engine(const char* det_path, const char* rec_path, const char* keys_path);
 
-    // Perform OCR on an image file
+    // Perform OCR on an image file with the default engine
     // Returns a JSON string of recognized results (must be freed by the caller)
     EXPORT char* perform_ocr(const char* image_path);
 
+    // Perform OCR on an encoded image in memory with the default engine
+    EXPORT char* perform_ocr_from_buffer(const uint8_t* data, size_t len);
+
+    // Perform OCR on decoded pixels in caller memory with the default engine
+    EXPORT char* perform_ocr_from_pixels(const uint8_t* pixels, int width, int height, int stride, int format);
+
+    // Perform OCR on several image files with the default engine (see ocr_engine_run_batch)
+    EXPORT int perform_ocr_batch(const char** image_paths, size_t count, char** results);
+
     // Free the string returned by perform_ocr
     EXPORT void free_ocr_result(char* result);
 }